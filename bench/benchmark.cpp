@@ -0,0 +1,544 @@
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "core.hpp"
+#include "utils.hpp"
+#include "texture.hpp"
+#include "textureData.hpp"
+#include "environmentMap.hpp"
+#include "lambertBrdf.hpp"
+#include "solidMaterial.hpp"
+#include "sphere.hpp"
+#include "plane.hpp"
+#include "rectangle.hpp"
+#include "ellipse.hpp"
+#include "group.hpp"
+#include "instance.hpp"
+#include "transform.hpp"
+#include "pointLight.hpp"
+#include "scene.hpp"
+#include "camera.hpp"
+#include "renderer.hpp"
+#include "scratchArena.hpp"
+#include "sampler.hpp"
+#include "lightTree.hpp"
+#include "postProcess.hpp"
+
+//Micro-benchmarks of the renderer's hot code. Every benchmark is calibrated to run
+//for at least MIN_TIME seconds, repeated REPEATS times and the fastest run is kept.
+//Results are printed as one JSON object per line:
+//  {"benchmark": "...", "unit": "ray", "ns_per_op": ..., "ops_per_second": ...}
+//Usage: PathTracerBenchmark [filter] -- runs benchmarks whose name contains filter
+
+namespace
+{
+  const double MIN_TIME = 0.05;
+  const int REPEATS = 5;
+  const size_t RAY_COUNT = 4096;
+
+  volatile float sink;
+
+  class Benchmarks
+  {
+  private:
+    const char* m_filter;
+  public:
+    Benchmarks(const char* filter): m_filter(filter) {}
+
+    //body performs opsPerCall operations and returns a value which is kept alive
+    void run(const std::string& name, const char* unit, size_t opsPerCall, std::function<float()> body)
+    {
+      if(m_filter && name.find(m_filter) == std::string::npos) return;
+
+      typedef std::chrono::steady_clock Clock;
+      size_t calls = 1;
+      double best = 0.0;
+      float result = 0.0f;
+      for(;;)
+      {
+        Clock::time_point start = Clock::now();
+        for(size_t i = 0; i < calls; ++i)
+          result += body();
+        double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+        if(elapsed >= MIN_TIME)
+        {
+          best = elapsed;
+          break;
+        }
+        calls *= 2;
+      }
+      for(int r = 1; r < REPEATS; ++r)
+      {
+        Clock::time_point start = Clock::now();
+        for(size_t i = 0; i < calls; ++i)
+          result += body();
+        best = std::min(best, std::chrono::duration<double>(Clock::now() - start).count());
+      }
+      sink = result;
+
+      double ops = (double)calls * opsPerCall;
+      std::printf("{\"benchmark\": \"%s\", \"unit\": \"%s\", \"ns_per_op\": %.3f, \"ops_per_second\": %.1f}\n",
+                  name.c_str(), unit, best * 1e9 / ops, ops / best);
+      std::fflush(stdout);
+    }
+  };
+
+  Vector randomDirection(RNG& rng)
+  {
+    for(;;)
+    {
+      Vector d(2.0f * rng.get() - 1.0f, 2.0f * rng.get() - 1.0f, 2.0f * rng.get() - 1.0f);
+      float lenSq = d.lengthSq();
+      if(lenSq > 0.0001f && lenSq <= 1.0f) return d / sqrtf(lenSq);
+    }
+  }
+
+  std::vector<Ray> randomRays(RNG& rng, float extent)
+  {
+    std::vector<Ray> rays;
+    for(size_t i = 0; i < RAY_COUNT; ++i)
+    {
+      Vector origin((2.0f * rng.get() - 1.0f) * extent, (2.0f * rng.get() - 1.0f) * extent, (2.0f * rng.get() - 1.0f) * extent);
+      rays.push_back(Ray(origin, randomDirection(rng)));
+    }
+    return rays;
+  }
+
+  //Spheres, rectangles and ellipses spread over a cube, their size shrinks with the
+  //count so the cube stays about equally filled
+  void fillScene(Scene& scene, RNG& rng, unsigned int count)
+  {
+    float size = 4.0f / cbrtf((float)count);
+    for(unsigned int i = 0; i < count; ++i)
+    {
+      Vector position((2.0f * rng.get() - 1.0f) * 10.0f, (2.0f * rng.get() - 1.0f) * 10.0f, (2.0f * rng.get() - 1.0f) * 10.0f);
+      Vector normal = randomDirection(rng);
+      Vector tangent = normal.cross(randomDirection(rng)).normalize();
+      switch(i % 3)
+      {
+      case 0:
+        scene.addObject(std::make_shared<Sphere>(position, size * (0.5f + rng.get())));
+        break;
+      case 1:
+        scene.addObject(std::make_shared<Rectangle>(position, normal, tangent, size * (1.0f + rng.get()), size * (1.0f + rng.get())));
+        break;
+      default:
+        scene.addObject(std::make_shared<Ellipse>(position, normal, tangent, size * (1.0f + rng.get()), size * (1.0f + rng.get())));
+        break;
+      }
+    }
+  }
+
+  //Closed box with two spheres and an area light, close to the scene in main.cpp
+  //The ceiling lamp is split into a lampGrid x lampGrid array of panels
+  void fillRoom(Scene& scene, unsigned int lampGrid = 1)
+  {
+    std::shared_ptr<BaseMaterial> white = std::make_shared<SolidMaterial>(Vector(1, 1, 1), 0.81f);
+    std::shared_ptr<BaseMaterial> red = std::make_shared<SolidMaterial>(Vector(0.8f, 0.2f, 0.2f), 0.81f);
+    std::shared_ptr<BaseMaterial> lamp = std::make_shared<SolidMaterial>(Vector(1, 1, 1), 0.1f, Vector(5, 5, 5));
+
+    scene.addObject(std::make_shared<Rectangle>(Vector(-2, -1, -1), Vector(1, 0, 0), Vector(0, 0, 1), Vector(0, 1, 0), 3, 3, red));
+    scene.addObject(std::make_shared<Rectangle>(Vector(2, 2, 2), Vector(-1, 0, 0), Vector(0, 0, -1), Vector(0, -1, 0), 3, 3, white));
+    scene.addObject(std::make_shared<Rectangle>(Vector(-2, -1, -1), Vector(0, 1, 0), Vector(1, 0, 0), Vector(0, 0, 1), 4, 3, white));
+    scene.addObject(std::make_shared<Rectangle>(Vector(-2, 2, -1), Vector(0, -1, 0), Vector(1, 0, 0), Vector(0, 0, 1), 4, 3, white));
+    scene.addObject(std::make_shared<Rectangle>(Vector(-2, -1, 2), Vector(0, 0, -1), Vector(1, 0, 0), Vector(0, 1, 0), 4, 3, white));
+    scene.addObject(std::make_shared<Rectangle>(Vector(-2, -1, -1), Vector(0, 0, 1), Vector(1, 0, 0), Vector(0, 1, 0), 4, 3, white));
+    scene.addObject(std::make_shared<Sphere>(Vector(-0.8f, -0.5f, 0.8f), 0.5f, white));
+    scene.addObject(std::make_shared<Sphere>(Vector(0.6f, -0.5f, 0.3f), 0.5f, white));
+    float panelX = 1.2f / lampGrid, panelZ = 0.6f / lampGrid;
+    for(unsigned int i = 0; i < lampGrid; ++i)
+    {
+      for(unsigned int j = 0; j < lampGrid; ++j)
+      {
+        Vector corner(-0.6f + i * panelX, 1.99f, 0.6f + j * panelZ);
+        scene.addObject(std::make_shared<Rectangle>(corner, Vector(0, -1, 0), Vector(1, 0, 0), 0.8f * panelX, 0.8f * panelZ, lamp));
+      }
+    }
+    scene.addLight(std::make_shared<PointLight>(Vector(0, 1.5f, 0), Vector(1, 1, 1), 2.0f));
+  }
+
+  Texture checkerTexture(int width, int height)
+  {
+    std::vector<float> data(3 * width * height);
+    for(int y = 0; y < height; ++y)
+    {
+      for(int x = 0; x < width; ++x)
+      {
+        float c = ((x / 8 + y / 8) % 2) ? 0.9f : 0.1f;
+        for(int k = 0; k < 3; ++k)
+          data[3 * (y * width + x) + k] = c;
+      }
+    }
+    return Texture(width, height, data.data());
+  }
+
+  //The same checker in 8-bit sRGB, the format of textures loaded from files
+  Texture checkerTextureSRGB(int width, int height)
+  {
+    std::vector<uint8_t> data(3 * width * height);
+    for(int y = 0; y < height; ++y)
+    {
+      for(int x = 0; x < width; ++x)
+      {
+        uint8_t c = ((x / 8 + y / 8) % 2) ? 243 : 89;
+        for(int k = 0; k < 3; ++k)
+          data[3 * (y * width + x) + k] = c;
+      }
+    }
+    return Texture(std::make_shared<const TextureData>(width, height, data.data()));
+  }
+
+  template <typename T>
+  void benchmarkShape(Benchmarks& b, const std::string& name, const T& shape, const std::vector<Ray>& rays)
+  {
+    b.run(name + ".intersect", "ray", rays.size(), [&]()
+    {
+      float sum = 0.0f;
+      for(size_t i = 0; i < rays.size(); ++i)
+        sum += shape.intersect(rays[i]);
+      return sum;
+    });
+  }
+
+  void benchmarkScene(Benchmarks& b, const std::string& name, const Scene& scene, const std::vector<Ray>& rays)
+  {
+    b.run(name + ".intersect", "ray", rays.size(), [&]()
+    {
+      float sum = 0.0f, t;
+      for(size_t i = 0; i < rays.size(); ++i)
+      {
+        scene.intersect(rays[i], &t, nullptr);
+        sum += t;
+      }
+      return sum;
+    });
+    b.run(name + ".occlusionTest", "ray", rays.size(), [&]()
+    {
+      float count = 0.0f;
+      for(size_t i = 0; i < rays.size(); ++i)
+        count += scene.occlusionTest(rays[i], 5.0f) ? 1.0f : 0.0f;
+      return count;
+    });
+  }
+}
+
+int main(int argc, char** argv)
+{
+  Benchmarks b(argc > 1 ? argv[1] : nullptr);
+  RNG rng(1234);
+
+  std::vector<Ray> rays = randomRays(rng, 2.0f);
+  benchmarkShape(b, "sphere", Sphere(Vector(0, 0, 0), 1.0f), rays);
+  benchmarkShape(b, "rectangle", Rectangle(Vector(-1, -1, 0), Vector(0, 0, 1), Vector(1, 0, 0), 2.0f, 2.0f), rays);
+  benchmarkShape(b, "ellipse", Ellipse(Vector(0, 0, 0), Vector(0, 0, 1), Vector(1, 0, 0), 1.5f, 1.0f), rays);
+  benchmarkShape(b, "plane", Plane(Vector(0, 0, 0), Vector(0, 1, 0)), rays);
+
+  std::vector<Ray> sceneRays = randomRays(rng, 12.0f);
+  const unsigned int counts[] = {16, 256, 4096};
+  for(unsigned int count : counts)
+  {
+    Scene scene;
+    fillScene(scene, rng, count);
+    std::string suffix = std::to_string(count);
+
+    scene.build(Acceleration::BVH);
+    benchmarkScene(b, "scene.bvh." + suffix, scene, sceneRays);
+    if(count <= 256)
+    {
+      scene.build(Acceleration::Compiled);
+      benchmarkScene(b, "scene.compiled." + suffix, scene, sceneRays);
+      //addObject() drops the acceleration structure, a copy without build() is linear
+      Scene linear;
+      for(const std::shared_ptr<Object>& object : scene.getObjects())
+        linear.addObject(object);
+      benchmarkScene(b, "scene.linear." + suffix, linear, sceneRays);
+    }
+  }
+
+  //64 rotated copies of a group of 256 objects, the same number of objects as scene.bvh.4096
+  //with 256 objects' worth of memory and hierarchy
+  {
+    Scene parts;
+    fillScene(parts, rng, 256);
+    std::shared_ptr<Group> group = std::make_shared<Group>(parts.getObjects());
+    Scene scene;
+    for(unsigned int i = 0; i < 64; ++i)
+    {
+      Vector offset((2.0f * rng.get() - 1.0f) * 8.0f, (2.0f * rng.get() - 1.0f) * 8.0f, (2.0f * rng.get() - 1.0f) * 8.0f);
+      Transform toWorld = Transform::translation(offset) * Transform::rotation(randomDirection(rng), 360.0f * rng.get()) * Transform::scaling(Vector(0.25f, 0.25f, 0.25f));
+      scene.addObject(std::make_shared<Instance>(group, toWorld));
+    }
+    scene.build(Acceleration::BVH);
+    benchmarkScene(b, "scene.instanced.64x256", scene, sceneRays);
+  }
+
+  const size_t lookups = 4096;
+  std::vector<float> uv(2 * lookups);
+  std::vector<Vector> directions(lookups);
+  for(size_t i = 0; i < lookups; ++i)
+  {
+    uv[2*i] = rng.get();
+    uv[2*i + 1] = rng.get();
+    directions[i] = randomDirection(rng);
+  }
+
+  Texture texture = checkerTexture(512, 512);
+  b.run("texture.sample", "lookup", lookups, [&]()
+  {
+    float sum = 0.0f;
+    for(size_t i = 0; i < lookups; ++i)
+      sum += texture.sample(uv[2*i], uv[2*i + 1]).x;
+    return sum;
+  });
+
+  //Scattered lookups, as made by diverging rays, into a texture larger than the caches
+  Texture largeTexture = checkerTexture(4096, 4096);
+  b.run("texture.sample.4096", "lookup", lookups, [&]()
+  {
+    float sum = 0.0f;
+    for(size_t i = 0; i < lookups; ++i)
+      sum += largeTexture.sample(uv[2*i], uv[2*i + 1]).x;
+    return sum;
+  });
+
+  b.run("texture.sampleBilinear.4096", "lookup", lookups, [&]()
+  {
+    float sum = 0.0f;
+    for(size_t i = 0; i < lookups; ++i)
+      sum += largeTexture.sampleBilinear(uv[2*i], uv[2*i + 1]).x;
+    return sum;
+  });
+
+  //Footprints of a few texels, from level 0 up to level 3
+  b.run("texture.sampleTrilinear.4096", "lookup", lookups, [&]()
+  {
+    float sum = 0.0f;
+    for(size_t i = 0; i < lookups; ++i)
+      sum += largeTexture.sampleTrilinear(uv[2*i], uv[2*i + 1], (1 + (i & 7)) / 4096.0f).x;
+    return sum;
+  });
+
+  Texture largeTextureSRGB = checkerTextureSRGB(4096, 4096);
+  b.run("texture.sample.4096.srgb8", "lookup", lookups, [&]()
+  {
+    float sum = 0.0f;
+    for(size_t i = 0; i < lookups; ++i)
+      sum += largeTextureSRGB.sample(uv[2*i], uv[2*i + 1]).x;
+    return sum;
+  });
+
+  b.run("texture.sampleBilinear.4096.srgb8", "lookup", lookups, [&]()
+  {
+    float sum = 0.0f;
+    for(size_t i = 0; i < lookups; ++i)
+      sum += largeTextureSRGB.sampleBilinear(uv[2*i], uv[2*i + 1]).x;
+    return sum;
+  });
+
+  b.run("texture.sampleTrilinear.4096.srgb8", "lookup", lookups, [&]()
+  {
+    float sum = 0.0f;
+    for(size_t i = 0; i < lookups; ++i)
+      sum += largeTextureSRGB.sampleTrilinear(uv[2*i], uv[2*i + 1], (1 + (i & 7)) / 4096.0f).x;
+    return sum;
+  });
+
+  EnvironmentMap envMap(checkerTexture(512, 256));
+  b.run("environmentMap.sample", "lookup", lookups, [&]()
+  {
+    float sum = 0.0f;
+    for(size_t i = 0; i < lookups; ++i)
+      sum += envMap.sample(directions[i]).x;
+    return sum;
+  });
+
+  b.run("environmentMap.sampleDirection", "sample", lookups, [&]()
+  {
+    float sum = 0.0f, pdf;
+    for(size_t i = 0; i < lookups; ++i)
+      sum += envMap.sampleDirection(uv[2*i], uv[2*i + 1], pdf).x + pdf;
+    return sum;
+  });
+
+  b.run("environmentMap.getPDF", "lookup", lookups, [&]()
+  {
+    float sum = 0.0f;
+    for(size_t i = 0; i < lookups; ++i)
+      sum += envMap.getPDF(directions[i]);
+    return sum;
+  });
+
+  //Light samples taken from points spread below the emitters
+  Rectangle lamp(Vector(-0.5f, 2.0f, 0.3f), Vector(0, -1, 0), Vector(1, 0, 0), Vector(0, 0, 1), 1.0f, 0.6f);
+  Sphere bulb(Vector(0, 2.0f, 0.5f), 0.5f);
+  std::vector<Vector> references(lookups);
+  for(size_t i = 0; i < lookups; ++i)
+    references[i] = Vector(4.0f * rng.get() - 2.0f, 1.9f * rng.get() - 0.5f, 4.0f * rng.get() - 1.5f);
+
+  for(const Object* light : {(const Object*)&lamp, (const Object*)&bulb})
+  {
+    std::string name = light == &lamp ? "rectangle" : "sphere";
+    b.run(name + ".getSample", "sample", lookups, [&]()
+    {
+      float sum = 0.0f;
+      for(size_t i = 0; i < lookups; ++i)
+        sum += light->getSample(uv[2*i], uv[2*i + 1]).point.x;
+      return sum;
+    });
+
+    b.run(name + ".getSampleFrom", "sample", lookups, [&]()
+    {
+      float sum = 0.0f, pdf;
+      for(size_t i = 0; i < lookups; ++i)
+        sum += light->getSampleFrom(references[i], uv[2*i], uv[2*i + 1], pdf).point.x + pdf;
+      return sum;
+    });
+  }
+
+  LambertBRDF brdf(0.81f);
+  b.run("lambertBrdf.sample_f", "sample", lookups, [&]()
+  {
+    float sum = 0.0f, pdf;
+    Vector wo(0, 1, 0), wi;
+    for(size_t i = 0; i < lookups; ++i)
+      sum += brdf.sample_f(wo, wi, uv[2*i], uv[2*i + 1], pdf) * pdf;
+    return sum;
+  });
+
+  b.run("rng.get", "number", lookups, [&]()
+  {
+    float sum = 0.0f;
+    for(size_t i = 0; i < lookups; ++i)
+      sum += rng.get();
+    return sum;
+  });
+
+  b.run("createOrthogonalSystem", "call", lookups, [&]()
+  {
+    float sum = 0.0f;
+    Vector tangent, bitangent;
+    for(size_t i = 0; i < lookups; ++i)
+    {
+      createOrthogonalSystem(directions[i], tangent, bitangent);
+      sum += tangent.x + bitangent.y;
+    }
+    return sum;
+  });
+
+  //Post-processing of a 1080p HDR image on one thread. Tone mapping runs on its own output
+  //again and again, which keeps the values in range.
+  std::vector<Vector> image(1920 * 1080);
+  for(size_t i = 0; i < image.size(); ++i)
+    image[i] = Vector(rng.get(), rng.get(), rng.get()) * 4.0f;
+  std::vector<char> pixels(3 * image.size());
+  PostProcess post;
+  post.THREADS = 1;
+  post.addOperator(std::make_shared<ReinhardOperator>());
+  b.run("postProcess.reinhard", "pixel", image.size(), [&]()
+  {
+    post.apply(image);
+    return image[0].x;
+  });
+
+  b.run("postProcess.encodeSRGB", "pixel", image.size(), [&]()
+  {
+    post.encodeSRGB(image, pixels.data());
+    return (float)pixels[0];
+  });
+
+  Scene room;
+  fillRoom(room);
+  room.build();
+  LightTree lightTree;
+  Renderer::buildLightTree(room, lightTree);
+  Camera camera(90, Vector(0, 0, -1), Vector(0, 0, 1), Vector(0, 1, 0));
+  Renderer renderer(64, 64);
+  ScratchArena arena;
+  const unsigned int paths = 256;
+  const SamplerType samplerTypes[] = {SamplerType::Random, SamplerType::Sobol, SamplerType::Halton, SamplerType::BlueNoise};
+  for(SamplerType type : samplerTypes)
+  {
+    std::unique_ptr<Sampler> sampler = Sampler::create(type, 1234);
+    std::string name = Sampler::getName(type);
+    std::replace(name.begin(), name.end(), ' ', '_');
+    std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+    uint32_t index = 0;
+    b.run("sampler." + name + ".get2D", "sample", lookups, [&]()
+    {
+      float sum = 0.0f, u1, u2;
+      for(size_t i = 0; i < lookups; ++i)
+      {
+        sampler->startSample(i % 64, i / 64, index);
+        sampler->get2D(u1, u2);
+        sum += u1 + u2;
+      }
+      ++index;
+      return sum;
+    });
+
+    b.run("renderer.traceRay." + name, "path", paths, [&]()
+    {
+      float sum = 0.0f;
+      for(unsigned int i = 0; i < paths; ++i)
+      {
+        sampler->startSample(i % 16, i / 16, index);
+        float jitterX, jitterY;
+        sampler->get2D(jitterX, jitterY);
+        Ray ray = camera.getCameraRay(2.0f * jitterX - 1.0f, 2.0f * jitterY - 1.0f);
+        sum += renderer.traceRay(ray, room, lightTree, *sampler, arena, 2, 2).y;
+      }
+      ++index;
+      return sum;
+    });
+  }
+
+  //The cost of a path should barely depend on the number of lamps
+  for(unsigned int lampGrid : {1, 8, 32})
+  {
+    Scene lampRoom;
+    fillRoom(lampRoom, lampGrid);
+    lampRoom.build();
+    LightTree lampTree;
+    Renderer::buildLightTree(lampRoom, lampTree);
+    std::string lamps = std::to_string(lampGrid * lampGrid);
+
+    b.run("lightTree.sample." + lamps, "pick", lookups, [&]()
+    {
+      float sum = 0.0f, pmf;
+      for(size_t i = 0; i < lookups; ++i)
+      {
+        Vector point(3.6f * (i % 64) / 64.0f - 1.8f, -1.0f, 2.8f * (i / 64 % 64) / 64.0f - 0.9f);
+        float u = (i + 0.5f) / lookups;
+        const Object* light = lampTree.sample(point, Vector(0, 1, 0), u, pmf);
+        sum += light ? pmf + u : 0.0f;
+      }
+      return sum;
+    });
+
+    std::unique_ptr<Sampler> sampler = Sampler::create(SamplerType::Sobol, 1234);
+    uint32_t index = 0;
+    b.run("renderer.traceRay.lamps." + lamps, "path", paths, [&]()
+    {
+      float sum = 0.0f;
+      for(unsigned int i = 0; i < paths; ++i)
+      {
+        sampler->startSample(i % 16, i / 16, index);
+        float jitterX, jitterY;
+        sampler->get2D(jitterX, jitterY);
+        Ray ray = camera.getCameraRay(2.0f * jitterX - 1.0f, 2.0f * jitterY - 1.0f);
+        sum += renderer.traceRay(ray, lampRoom, lampTree, *sampler, arena, 2, 2).y;
+      }
+      ++index;
+      return sum;
+    });
+  }
+
+  return 0;
+}
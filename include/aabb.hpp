@@ -0,0 +1,70 @@
+#pragma once
+
+#include <limits>
+#include <algorithm>
+
+#include "vector.hpp"
+#include "core.hpp"
+
+class AABB
+{
+public:
+  Vector min, max;
+
+  AABB(): min(Vector(std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max())),
+          max(Vector(-std::numeric_limits<float>::max(), -std::numeric_limits<float>::max(), -std::numeric_limits<float>::max())) {}
+  AABB(const Vector& mn, const Vector& mx): min(mn), max(mx) {}
+
+  bool isEmpty() const { return min.x > max.x || min.y > max.y || min.z > max.z; }
+
+  void extend(const Vector& point)
+  {
+    min = Vector(std::min(min.x, point.x), std::min(min.y, point.y), std::min(min.z, point.z));
+    max = Vector(std::max(max.x, point.x), std::max(max.y, point.y), std::max(max.z, point.z));
+  }
+  void extend(const AABB& box)
+  {
+    min = Vector(std::min(min.x, box.min.x), std::min(min.y, box.min.y), std::min(min.z, box.min.z));
+    max = Vector(std::max(max.x, box.max.x), std::max(max.y, box.max.y), std::max(max.z, box.max.z));
+  }
+  void pad(float eps)
+  {
+    min -= Vector(eps, eps, eps);
+    max += Vector(eps, eps, eps);
+  }
+
+  Vector getCenter() const { return (min + max) * 0.5f; }
+  float getSurfaceArea() const
+  {
+    if(isEmpty()) return 0.0f;
+    Vector d = max - min;
+    return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+  }
+  int getLongestAxis() const
+  {
+    Vector d = max - min;
+    if(d.x > d.y && d.x > d.z) return 0;
+    return d.y > d.z ? 1 : 2;
+  }
+
+  //Slab test, invDir is the componentwise reciprocal of the ray direction
+  bool intersect(const Ray& ray, const Vector& invDir, float tMax, float& tNear) const
+  {
+    float t0 = (min.x - ray.origin.x) * invDir.x;
+    float t1 = (max.x - ray.origin.x) * invDir.x;
+    float tmin = std::min(t0, t1), tmax = std::max(t0, t1);
+
+    t0 = (min.y - ray.origin.y) * invDir.y;
+    t1 = (max.y - ray.origin.y) * invDir.y;
+    tmin = std::max(tmin, std::min(t0, t1));
+    tmax = std::min(tmax, std::max(t0, t1));
+
+    t0 = (min.z - ray.origin.z) * invDir.z;
+    t1 = (max.z - ray.origin.z) * invDir.z;
+    tmin = std::max(tmin, std::min(t0, t1));
+    tmax = std::min(tmax, std::max(t0, t1));
+
+    tNear = tmin;
+    return tmax >= std::max(tmin, 0.0f) && tmin <= tMax;
+  }
+};
@@ -0,0 +1,9 @@
+#pragma once
+
+#include <cstddef>
+
+//With the PATHTRACER_COUNT_ALLOCATIONS CMake option the global operator new is
+//replaced by one that counts calls per thread. Without it the count stays 0.
+bool isAllocationCountingEnabled();
+//Number of operator new calls made by the calling thread so far
+size_t getThreadAllocationCount();
@@ -6,7 +6,9 @@ class Vector;
 class BaseMaterial
 {
 public:
-  virtual Vector getColor(float u, float v) const = 0;
+  //footprint is the width in texture coordinates the lookup stands for, textures are
+  //filtered over it (0 - a single point)
+  virtual Vector getColor(float u, float v, float footprint = 0.0f) const = 0;
   virtual Vector getEmittance(float u, float v) const = 0;
   virtual bool isEmissive() const = 0;
   virtual BRDF* getBRDF() const = 0;
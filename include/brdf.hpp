@@ -1,12 +1,14 @@
 #pragma once
 
 class Vector;
-class RNG;
 
 class BRDF
 {
 public:
   virtual float f(const Vector& wo, const Vector& wi) const = 0;
-  virtual float sample_f(const Vector& wo, Vector& wi, RNG& rng, float& pdf) const = 0;
+  //u1, u2 -- point of the unit square mapped to the sampled direction
+  virtual float sample_f(const Vector& wo, Vector& wi, float u1, float u2, float& pdf) const = 0;
+  //Density with which sample_f picks wi, both directions in the frame of sample_f (normal along y)
+  virtual float pdf(const Vector& wo, const Vector& wi) const = 0;
   virtual ~BRDF() {};
 };
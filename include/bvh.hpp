@@ -0,0 +1,156 @@
+#pragma once
+
+#include <vector>
+
+#include "aabb.hpp"
+
+struct BVHNode
+{
+  AABB bounds;
+  //Leaves: index of the first primitive, interior nodes: index of the second child
+  //(the first child always directly follows its parent)
+  unsigned int offset;
+  unsigned short count;
+  unsigned short axis;
+};
+
+//Bounding volume hierarchy built with the surface area heuristic.
+//The hierarchy only knows about boxes - primitives are tested through callbacks,
+//which receive the position of the primitive in getIndices().
+class BVH
+{
+private:
+  struct BuildEntry
+  {
+    AABB bounds;
+    Vector centroid;
+    unsigned int index;
+  };
+
+  std::vector<BVHNode> m_nodes;
+  std::vector<unsigned int> m_indices;
+  //Nodes built elsewhere (see adopt), traversed instead of m_nodes
+  const BVHNode* m_adopted;
+  size_t m_adoptedCount;
+
+  void buildRecursive(std::vector<BuildEntry>& entries, unsigned int nodeIndex, unsigned int begin, unsigned int end, unsigned int depth);
+  static Vector inverseDirection(const Vector& dir);
+public:
+  static const unsigned int MAX_LEAF_SIZE = 4;
+  static const unsigned int STACK_SIZE = 64;
+
+  BVH(): m_adopted(nullptr), m_adoptedCount(0) {}
+
+  void build(const std::vector<AABB>& bounds);
+  //Traverses nodes built earlier (e.g. stored in a file) over primitives already stored in
+  //their leaf order, getIndices() stays empty. The nodes are not copied and have to outlive
+  //the hierarchy. False, leaving the hierarchy empty, unless the nodes form a tree over
+  //primitiveCount primitives which can be traversed with STACK_SIZE entries.
+  bool adopt(const BVHNode* nodes, size_t nodeCount, size_t primitiveCount);
+  void clear();
+
+  bool isEmpty() const { return getNodeCount() == 0; }
+  AABB getBounds() const { return isEmpty() ? AABB() : getNodes()[0].bounds; }
+  //Original index of every primitive, in the order the leaves reference them
+  const std::vector<unsigned int>& getIndices() const { return m_indices; }
+  const BVHNode* getNodes() const { return m_adopted ? m_adopted : m_nodes.data(); }
+  size_t getNodeCount() const { return m_adopted ? m_adoptedCount : m_nodes.size(); }
+
+  //intersectPrimitive(i, tMax) tests primitive i and shrinks tMax on a closer hit
+  template <typename F>
+  bool intersect(const Ray& ray, float& tMax, F intersectPrimitive) const;
+  //testPrimitive(i) returns true as soon as primitive i blocks the ray
+  template <typename F>
+  bool occluded(const Ray& ray, float maxT, F testPrimitive) const;
+};
+
+inline Vector BVH::inverseDirection(const Vector& dir)
+{
+  return Vector(1.0f / dir.x, 1.0f / dir.y, 1.0f / dir.z);
+}
+
+template <typename F>
+bool BVH::intersect(const Ray& ray, float& tMax, F intersectPrimitive) const
+{
+  if(isEmpty()) return false;
+
+  Vector invDir = inverseDirection(ray.direction);
+  bool negative[3] = {invDir.x < 0.0f, invDir.y < 0.0f, invDir.z < 0.0f};
+  const BVHNode* nodes = getNodes();
+  unsigned int stack[STACK_SIZE];
+  unsigned int stackSize = 0;
+  unsigned int current = 0;
+  bool hit = false;
+  float tNear;
+
+  for(;;)
+  {
+    const BVHNode& node = nodes[current];
+    if(node.bounds.intersect(ray, invDir, tMax, tNear))
+    {
+      if(node.count > 0)
+      {
+        for(unsigned int i = node.offset; i < node.offset + node.count; ++i)
+        {
+          if(intersectPrimitive(i, tMax)) hit = true;
+        }
+      }
+      else
+      {
+        //Visit the child lying closer along the ray first
+        if(negative[node.axis])
+        {
+          stack[stackSize++] = current + 1;
+          current = node.offset;
+        }
+        else
+        {
+          stack[stackSize++] = node.offset;
+          current = current + 1;
+        }
+        continue;
+      }
+    }
+    if(stackSize == 0) break;
+    current = stack[--stackSize];
+  }
+  return hit;
+}
+
+template <typename F>
+bool BVH::occluded(const Ray& ray, float maxT, F testPrimitive) const
+{
+  if(isEmpty()) return false;
+
+  Vector invDir = inverseDirection(ray.direction);
+  const BVHNode* nodes = getNodes();
+  unsigned int stack[STACK_SIZE];
+  unsigned int stackSize = 0;
+  unsigned int current = 0;
+  float tNear;
+  if(maxT < 0.0f) maxT = std::numeric_limits<float>::max();
+
+  for(;;)
+  {
+    const BVHNode& node = nodes[current];
+    if(node.bounds.intersect(ray, invDir, maxT, tNear))
+    {
+      if(node.count > 0)
+      {
+        for(unsigned int i = node.offset; i < node.offset + node.count; ++i)
+        {
+          if(testPrimitive(i)) return true;
+        }
+      }
+      else
+      {
+        stack[stackSize++] = node.offset;
+        current = current + 1;
+        continue;
+      }
+    }
+    if(stackSize == 0) break;
+    current = stack[--stackSize];
+  }
+  return false;
+}
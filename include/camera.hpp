@@ -20,4 +20,6 @@ public:
   Camera(): m_forward(Vector(0, 0, 1)), m_up(Vector(0, 1, 0)), m_right(Vector(1, 0, 0)), m_tanhalfFOV(1.0f), position(Vector(0, 0, -1)) {}
 
   Ray getCameraRay(float x, float y) const;
+  //Angle between the rays through the centers of two neighbouring pixels in an image of the given height
+  float getPixelSpread(unsigned int height) const { return 2.0f * m_tanhalfFOV / height; }
 };
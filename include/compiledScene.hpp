@@ -0,0 +1,57 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+
+#include "simdIntersect.hpp"
+
+class Object;
+class Ray;
+
+//Flat copy of a scene's primitives grouped by type into structure-of-arrays
+//buffers. Spheres, rectangles and ellipses are tested with the vectorized kernels
+//without touching the objects, everything else goes through Object::intersect.
+//Results are the same as testing every object in order.
+class CompiledScene
+{
+private:
+  struct SphereArrays
+  {
+    std::vector<float> centerX, centerY, centerZ, radius;
+  };
+  struct PlanarArrays
+  {
+    std::vector<float> pointX, pointY, pointZ;
+    std::vector<float> normalX, normalY, normalZ;
+    std::vector<float> tangentX, tangentY, tangentZ;
+    std::vector<float> bitangentX, bitangentY, bitangentZ;
+    std::vector<float> sizeTangent, sizeBitangent;
+  };
+
+  SphereArrays m_spheres;
+  PlanarArrays m_rectangles;
+  PlanarArrays m_ellipses;
+  SphereBatch m_sphereBatch;
+  RectangleBatch m_rectangleBatch;
+  EllipseBatch m_ellipseBatch;
+
+  //Index of the scene object every primitive came from
+  std::vector<unsigned int> m_sphereObjects;
+  std::vector<unsigned int> m_rectangleObjects;
+  std::vector<unsigned int> m_ellipseObjects;
+  std::vector<unsigned int> m_otherObjects;
+  std::vector<const Object*> m_others;
+
+  void updateBatches();
+public:
+  CompiledScene();
+  CompiledScene(const CompiledScene&) = delete;
+  CompiledScene& operator=(const CompiledScene&) = delete;
+
+  void build(const std::vector<std::shared_ptr<Object>>& objects);
+  void clear();
+
+  //Index of the closest object hit in (0, closestT) or -1
+  int intersect(const Ray& ray, float& closestT, unsigned int& primitive) const;
+  bool occlusionTest(const Ray& ray, float maxT) const;
+};
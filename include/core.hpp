@@ -2,8 +2,7 @@
 
 #include "vector.hpp"
 
-#include <chrono>
-#include <random>
+#include <cstdint>
 
 class Ray
 {
@@ -16,20 +15,51 @@ public:
   Vector operator()(float t) const { return origin + t*direction; };
 };
 
+//PCG32 (O'Neill, XSH RR variant): 16 bytes of state, reproducible and cheap to create.
+//Every get() consumes one dimension, forSample() gives every pixel sample its own sequence.
 class RNG
 {
 private:
-  std::mt19937 mt;
-  std::uniform_real_distribution<float> dist;
+  uint64_t m_state;
+  uint64_t m_inc;
+
+  static const uint64_t MULTIPLIER = 6364136223846793005ull;
+
+  void step() { m_state = m_state * MULTIPLIER + m_inc; }
 public:
-  RNG()
+  RNG(): RNG(0x853c49e6748fea9bull) {}
+  RNG(uint64_t seed, uint64_t stream = 0xda3e39cb94b95bdbull): m_state(0), m_inc((stream << 1) | 1)
+  {
+    step();
+    m_state += seed;
+    step();
+  }
+
+  unsigned int getUInt()
   {
-    mt.seed(std::chrono::system_clock::now().time_since_epoch().count());
+    uint64_t old = m_state;
+    step();
+    uint32_t xorshifted = (uint32_t)(((old >> 18) ^ old) >> 27);
+    uint32_t rot = (uint32_t)(old >> 59);
+    return (xorshifted >> rot) | (xorshifted << ((-rot) & 31));
   }
-  RNG(unsigned seed)
+
+  //Uniform in [0, 1), the top 24 bits fill the whole float mantissa
+  float get() { return (getUInt() >> 8) * (1.0f / 16777216.0f); }
+
+  //Generator of one sample of one pixel. Its sequence depends only on these values,
+  //never on the thread or tile which takes the sample.
+  static RNG forSample(uint64_t seed, uint64_t pixel, uint64_t sample)
   {
-    mt.seed(seed);
+    return RNG(mix(mix(seed ^ mix(pixel)) ^ sample));
   }
 
-  float get() { return dist(mt); }
-};
\ No newline at end of file
+  //SplitMix64 finalizer
+  static uint64_t mix(uint64_t h)
+  {
+    h += 0x9e3779b97f4a7c15ull;
+    h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ull;
+    h = (h ^ (h >> 27)) * 0x94d049bb133111ebull;
+    return h ^ (h >> 31);
+  }
+};
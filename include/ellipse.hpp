@@ -5,7 +5,6 @@
 
 class BaseMaterial;
 class Ray;
-class RNG;
 
 class Ellipse : public Object
 {
@@ -58,16 +57,20 @@ public:
     m_normal = m_axisT.cross(m_axisB).normalize();
   }
 
+  const Vector& getNormal() const { return m_normal; }
+  const Vector& getAxisTangent() const { return m_axisT; }
+  const Vector& getAxisBitangent() const { return m_axisB; }
   float getSemiTangent() const { return m_semiTangent; }
   float getSemiBitangent() const { return m_semiBitangent; }
   void setSemiTangent(float semiTangent);
   void setSemiBitangent(float semiBitangent);
 
   float intersect(const Ray& ray) const override;
-  Vector getNormalAt(const Vector&) const override;
-  void getUVAt(const Vector& point, float& u, float& v) const override;
+  Vector getNormalAt(const Vector&, unsigned int) const override;
+  void getUVAt(const Vector& point, unsigned int, float& u, float& v) const override;
+  AABB getBoundingBox() const override;
   bool isFinite() const override { return true; }
-  Vector getSample(RNG& rng) const override;
-  void getSamples(RNG& rng, int s1, int s2, Vector* samples) const override;
+  SurfaceSample getSample(float u1, float u2) const override;
   float getInversePDF() const override { return m_invPDF; }
+  void getNormalBounds(Vector& axis, float& cosTheta) const override { axis = m_normal; cosTheta = 1.0f; }
 };
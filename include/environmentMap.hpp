@@ -1,20 +1,42 @@
 #pragma once
 
 #include <memory>
+#include <vector>
 #include "texture.hpp"
 
 class Vector;
 
+//Latitude-longitude map of the radiance arriving from far away.
+//A piecewise constant distribution over its texels, weighted by luminance and by the
+//solid angle they cover, lets it be sampled as a light.
 class EnvironmentMap
 {
 private:
   Texture m_texture;
+  //Cells of the distribution, every texel is split into the same number of them
+  unsigned int m_width, m_height;
+  std::vector<float> m_weights;
+  //Cumulative distributions of the rows and of the cells within every row,
+  //each with one more entry than it has intervals
+  std::vector<float> m_marginalCDF;
+  std::vector<float> m_conditionalCDF;
+  float m_totalWeight;
+
+  void buildDistribution();
 public:
   EnvironmentMap();
-  EnvironmentMap(const Texture& texture): m_texture(texture) {}
-  EnvironmentMap(const Vector& color): m_texture(color) {}
-  EnvironmentMap(const char* fileName): m_texture(fileName) {}
+  EnvironmentMap(const Texture& texture);
+  EnvironmentMap(const Vector& color);
+  EnvironmentMap(const char* fileName);
 
+  //Radiance arriving from direction v
   Vector sample(const Vector& v) const;
   bool isValid() const { return m_texture.isValid(); }
+
+  //False for a black environment, which is never sampled
+  bool isSamplable() const { return m_totalWeight > 0.0f; }
+  //Direction picked in proportion to the radiance arriving from it, pdf is per unit solid angle
+  Vector sampleDirection(float u1, float u2, float& pdf) const;
+  //Density with which sampleDirection returns v
+  float getPDF(const Vector& v) const;
 };
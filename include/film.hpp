@@ -0,0 +1,79 @@
+#pragma once
+
+#include <vector>
+
+#include "vector.hpp"
+
+//HDR accumulation buffer holding the sum of radiance samples and the number of
+//samples of every pixel. Progressive rendering adds passes to it, a film saved to
+//a checkpoint file can be loaded later to continue where the render stopped.
+//A second buffer sums every other sample only, comparing both gives an estimate
+//of the remaining error of a pixel.
+//A film may hold part of an image only: a rectangle of its pixels and the samples from a
+//given index on, as rendered by one job of a distributed render. Films of the parts are
+//merged into a film of the whole image.
+class Film
+{
+private:
+  unsigned int m_width, m_height;
+  //Position of the film within the image and the size of the whole image
+  unsigned int m_left, m_top;
+  unsigned int m_imageWidth, m_imageHeight;
+  //Index of the first sample of every pixel, samples before it are rendered by other jobs
+  unsigned int m_firstSample;
+  std::vector<Vector> m_sum;
+  std::vector<Vector> m_halfSum;
+  std::vector<unsigned int> m_samples;
+  //Random numbers of a sample are derived from the seed, the pixel and the number
+  //of samples the pixel already has, so nothing else is needed to continue a render
+  unsigned int m_seed;
+  unsigned int m_passes;
+public:
+  Film(): m_width(0), m_height(0), m_left(0), m_top(0), m_imageWidth(0), m_imageHeight(0), m_firstSample(0), m_seed(0), m_passes(0) {}
+  Film(unsigned int width, unsigned int height, unsigned int seed);
+
+  //Clears the film, which then covers a whole image of width x height from sample 0 on
+  void reset(unsigned int width, unsigned int height, unsigned int seed);
+  //Places the film at (left, top) within an image of imageWidth x imageHeight
+  bool setRegion(unsigned int left, unsigned int top, unsigned int imageWidth, unsigned int imageHeight);
+  void setFirstSample(unsigned int firstSample) { m_firstSample = firstSample; }
+  //Adds the samples of a part of the same image (and seed) to this film, which has to
+  //cover the whole image. Parts may overlap, e.g. when they hold different samples.
+  bool merge(const Film& part);
+
+  //Every pixel is written by a single tile, so workers never share a pixel.
+  //halfSum holds the samples with an odd index, counting all samples of the pixel.
+  void addSamples(unsigned int x, unsigned int y, const Vector& sum, const Vector& halfSum, unsigned int count)
+  {
+    m_sum[y * m_width + x] += sum;
+    m_halfSum[y * m_width + x] += halfSum;
+    m_samples[y * m_width + x] += count;
+  }
+
+  //Mean of the samples, black for pixels without any
+  Vector getColor(unsigned int x, unsigned int y) const;
+  unsigned int getSampleCount(unsigned int x, unsigned int y) const { return m_samples[y * m_width + x]; }
+  unsigned int getMinSampleCount() const;
+  unsigned long long getTotalSampleCount() const;
+  //Difference between the mean of all samples and of every other sample relative
+  //to the square root of the brightness, infinite for pixels with fewer than 2 samples
+  float getError(unsigned int x, unsigned int y) const;
+
+  unsigned int getWidth() const { return m_width; }
+  unsigned int getHeight() const { return m_height; }
+  unsigned int getLeft() const { return m_left; }
+  unsigned int getTop() const { return m_top; }
+  unsigned int getImageWidth() const { return m_imageWidth; }
+  unsigned int getImageHeight() const { return m_imageHeight; }
+  unsigned int getFirstSample() const { return m_firstSample; }
+  unsigned int getSeed() const { return m_seed; }
+  unsigned int getPasses() const { return m_passes; }
+  void completePass() { ++m_passes; }
+
+  //Checkpoints are written to a temporary file first and then renamed,
+  //an interrupted write never destroys the previous checkpoint
+  bool save(const char* fileName) const;
+  bool load(const char* fileName);
+  //Writes the mean colors to a PFM image, row by row
+  bool savePFM(const char* fileName) const;
+};
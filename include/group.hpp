@@ -0,0 +1,45 @@
+#pragma once
+
+#include <vector>
+
+#include "object.hpp"
+#include "vector.hpp"
+#include "aabb.hpp"
+#include "bvh.hpp"
+
+//Objects with a hierarchy of their own, meant to be shared by instances (see Instance)
+//instead of being added to scenes one by one. The primitives of the parts are numbered
+//one after another, so a primitive index names both the part and its primitive.
+//Every part keeps its own material.
+class Group : public Object
+{
+private:
+  //Parts in the leaf order of m_bvh
+  std::vector<std::shared_ptr<Object>> m_objects;
+  //Index of the first primitive of every part
+  std::vector<unsigned int> m_firstPrimitives;
+  //Running sum of the areas of the parts, used to pick parts for samples
+  std::vector<float> m_areaCDF;
+  BVH m_bvh;
+  AABB m_bounds;
+  unsigned int m_primitiveCount;
+
+  size_t findPart(unsigned int primitive) const;
+public:
+  //Unbounded objects (planes) cannot be part of a group and are left out
+  Group(const std::vector<std::shared_ptr<Object>>& objects);
+
+  const std::vector<std::shared_ptr<Object>>& getObjects() const { return m_objects; }
+
+  float intersect(const Ray& ray) const override;
+  float intersectPrimitive(const Ray& ray, unsigned int& primitive) const override;
+  bool occludes(const Ray& ray, float maxT) const override;
+  Vector getNormalAt(const Vector& point, unsigned int primitive) const override;
+  void getUVAt(const Vector& point, unsigned int primitive, float& u, float& v) const override;
+  const BaseMaterial* getMaterial(unsigned int primitive) const override;
+  unsigned int getPrimitiveCount() const override { return m_primitiveCount; }
+  AABB getBoundingBox() const override { return m_bounds; }
+  bool isFinite() const override { return true; }
+  SurfaceSample getSample(float u1, float u2) const override;
+  float getInversePDF() const override { return m_areaCDF.empty() ? 0.0f : m_areaCDF.back(); }
+};
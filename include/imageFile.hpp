@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <vector>
+
+#include "mappedFile.hpp"
+
+class Vector;
+
+//Binary PPM (P6) or PFM (PF, Pf) image mapped into memory with its header parsed in place.
+//Pixels are read straight from the mapping.
+class ImageFile
+{
+public:
+  enum class Format
+  {
+    Invalid,
+    PPM,
+    PFM
+  };
+private:
+  MappedFile m_file;
+  Format m_format;
+  int m_width;
+  int m_height;
+  int m_channels;
+  //PPM: largest value, PFM: absolute value of the scale
+  float m_scale;
+  //PFM data is little endian when the scale in the header is negative
+  bool m_bigEndian;
+  const uint8_t* m_pixels;
+
+  bool parse();
+public:
+  explicit ImageFile(const char* fileName);
+
+  bool isValid() const { return m_format != Format::Invalid; }
+  Format getFormat() const { return m_format; }
+  int getWidth() const { return m_width; }
+  int getHeight() const { return m_height; }
+
+  //Row-major 8-bit sRGB RGB data within the mapping, nullptr unless the file is a PPM
+  //with a largest value of 255
+  const uint8_t* getSRGB() const;
+  //Row-major linear RGB data, top row first, converted from either format
+  std::vector<float> getLinear() const;
+};
+
+//Writes a linear RGB image to a little endian PFM file a row at a time. Rows go straight
+//to their place in the file, so they can be written in any order as they become available.
+class PFMWriter
+{
+private:
+  std::ofstream m_file;
+  int m_width;
+  int m_height;
+  std::streamoff m_pixelsStart;
+  std::vector<float> m_row;
+public:
+  PFMWriter(): m_width(0), m_height(0), m_pixelsStart(0) {}
+
+  bool open(const char* fileName, int width, int height);
+  //Row y counted from the top, as in the rest of the renderer
+  bool writeRow(int y, const Vector* pixels);
+  //False if any write failed
+  bool close();
+};
+
+//Writes an 8-bit binary PPM image a band of rows at a time, in any order
+class PPMWriter
+{
+private:
+  std::ofstream m_file;
+  int m_width;
+  int m_height;
+  std::streamoff m_pixelsStart;
+public:
+  PPMWriter(): m_width(0), m_height(0), m_pixelsStart(0) {}
+
+  bool open(const char* fileName, int width, int height);
+  //count rows starting at row y, 3 bytes per pixel
+  bool writeRows(int y, int count, const char* pixels);
+  //False if any write failed
+  bool close();
+};
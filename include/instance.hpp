@@ -0,0 +1,41 @@
+#pragma once
+
+#include "object.hpp"
+#include "vector.hpp"
+#include "aabb.hpp"
+#include "transform.hpp"
+
+//Shared geometry (any object, usually a Group) placed in the scene with an affine transform.
+//Rays are transformed into the space of the object and normals back into world space, so every
+//copy costs an instance instead of a copy of the geometry and its hierarchy.
+//Instances are not sampled as area lights, emissive parts are only found by BRDF sampling.
+class Instance : public Object
+{
+private:
+  std::shared_ptr<const Object> m_object;
+  Transform m_toWorld, m_toObject;
+  AABB m_bounds;
+  //Change of area from object to world space, exact for rotations and uniform scales
+  float m_areaScale;
+
+  //The direction of the returned ray is normalized, distances along it are scale
+  //times the distances along ray
+  Ray toObject(const Ray& ray, float& scale) const;
+public:
+  Instance(std::shared_ptr<const Object> object, const Transform& toWorld);
+
+  const Object& getObject() const { return *m_object; }
+  const Transform& getTransform() const { return m_toWorld; }
+
+  float intersect(const Ray& ray) const override;
+  float intersectPrimitive(const Ray& ray, unsigned int& primitive) const override;
+  bool occludes(const Ray& ray, float maxT) const override;
+  Vector getNormalAt(const Vector& point, unsigned int primitive) const override;
+  void getUVAt(const Vector& point, unsigned int primitive, float& u, float& v) const override;
+  const BaseMaterial* getMaterial(unsigned int primitive) const override { return m_object->getMaterial(primitive); }
+  unsigned int getPrimitiveCount() const override { return m_object->getPrimitiveCount(); }
+  AABB getBoundingBox() const override { return m_bounds; }
+  bool isFinite() const override { return m_object->isFinite(); }
+  SurfaceSample getSample(float u1, float u2) const override;
+  float getInversePDF() const override { return m_object->getInversePDF() * m_areaScale; }
+};
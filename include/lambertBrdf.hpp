@@ -10,5 +10,6 @@ public:
   LambertBRDF(float diffuseFactor): diffuseFactor(diffuseFactor) {}
 
   float f(const Vector&, const Vector&) const override;
-  float sample_f(const Vector&, Vector& wi, RNG& rng, float& pdf) const override;
+  float sample_f(const Vector&, Vector& wi, float u1, float u2, float& pdf) const override;
+  float pdf(const Vector&, const Vector& wi) const override;
 };
\ No newline at end of file
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+
+#include "aabb.hpp"
+
+class Object;
+
+//Where a group of emitters lies, which way it faces and how much it emits.
+//Every emitting normal is within the angle acos(cosTheta) of axis.
+struct LightBounds
+{
+  AABB bounds;
+  Vector axis;
+  float cosTheta;
+  float power;
+
+  LightBounds(): axis(0, 0, 1), cosTheta(1.0f), power(0.0f) {}
+
+  void extend(const LightBounds& other);
+};
+
+//LightBounds reduced to what importance() needs: a bounding sphere instead of the box
+struct LightTreeNode
+{
+  Vector center;
+  float radius;
+  Vector axis;
+  float cosTheta, sinTheta;
+  float power;
+  //Leaves: index of the light, interior nodes: index of the second child
+  //(the first child always directly follows its parent)
+  unsigned int offset;
+  bool leaf;
+
+  void setBounds(const LightBounds& lb);
+  //Conservative estimate of the light a receiver at point with the given normal gets,
+  //zero only if none of the emitters can reach it
+  float importance(const Vector& point, const Vector& normal) const;
+};
+
+//Hierarchy over the area lights which picks one of them in proportion to its
+//estimated contribution to a shading point (Conty Estevez and Kulla, "Importance
+//Sampling of Many Lights with Adaptive Tree Splitting"). A pick costs one walk from
+//the root to a leaf, however many lights there are.
+class LightTree
+{
+private:
+  struct BuildEntry
+  {
+    LightBounds bounds;
+    unsigned int index;
+  };
+
+  std::vector<const Object*> m_lights;
+  std::vector<LightTreeNode> m_nodes;
+  //Path from the root to the leaf of every light, one bit per level (1 - second child),
+  //above the highest set bit
+  std::vector<uint64_t> m_trails;
+  std::unordered_map<const Object*, unsigned int> m_lightIndices;
+
+  void buildRecursive(std::vector<BuildEntry>& entries, unsigned int nodeIndex, unsigned int begin, unsigned int end, uint64_t trail, unsigned int depth);
+  static LightBounds getLightBounds(const Object& light);
+public:
+  LightTree() {}
+
+  //Lights which do not emit anything are left out
+  void build(const std::vector<const Object*>& lights);
+  void clear();
+
+  bool isEmpty() const { return m_nodes.empty(); }
+  const std::vector<const Object*>& getLights() const { return m_lights; }
+
+  //Picks a light for a shading point, returns null if no light can reach it.
+  //u is consumed and rescaled to [0, 1) again, so it can be reused to sample the light.
+  const Object* sample(const Vector& point, const Vector& normal, float& u, float& pmf) const;
+  //Probability that sample() picks light for the shading point
+  float getPMF(const Vector& point, const Vector& normal, const Object* light) const;
+};
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+//Read-only view of a whole file. On POSIX systems the file is memory-mapped, so its pages
+//come from the page cache and are shared by every process reading the same file.
+//Elsewhere it is read into memory.
+class MappedFile
+{
+private:
+  const uint8_t* m_data;
+  size_t m_size;
+  //Contents of the file where it cannot be mapped
+  std::vector<uint8_t> m_buffer;
+
+  void close();
+public:
+  MappedFile(): m_data(nullptr), m_size(0) {}
+  explicit MappedFile(const char* fileName);
+  MappedFile(MappedFile&& other);
+  MappedFile& operator=(MappedFile&& other);
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+  ~MappedFile();
+
+  //Empty files count as not open
+  bool isOpen() const { return m_data != nullptr; }
+  const uint8_t* getData() const { return m_data; }
+  size_t getSize() const { return m_size; }
+};
@@ -0,0 +1,8 @@
+#pragma once
+
+struct MeshData;
+
+//Reads a Wavefront OBJ file line by line. Polygons are triangulated as fans and
+//v/vt/vn combinations are merged into shared vertices. Materials, groups and
+//everything else besides geometry are ignored.
+bool loadOBJ(const char* fileName, MeshData& mesh);
@@ -2,11 +2,21 @@
 
 #include <memory>
 
+#include "vector.hpp"
+
 class BaseMaterial;
-class Vector;
-class RNG;
 class Ray;
+class AABB;
+
+struct SurfaceSample
+{
+  Vector point;
+  unsigned int primitive;
+};
 
+//Objects consisting of several primitives (triangle meshes) report which one
+//a ray hit, so normals and texture coordinates can be looked up for it.
+//Simple shapes are a single primitive with index 0.
 class Object
 {
 public:
@@ -14,12 +24,29 @@ public:
 
   Object();
   Object(std::shared_ptr<BaseMaterial> mat): material(mat) {}
+  virtual ~Object() {}
 
   virtual float intersect(const Ray& ray) const = 0;
-  virtual Vector getNormalAt(const Vector &point) const = 0;
-  virtual void getUVAt(const Vector &point, float& u, float& v) const = 0;
+  virtual float intersectPrimitive(const Ray& ray, unsigned int& primitive) const { primitive = 0; return intersect(ray); }
+  virtual bool occludes(const Ray& ray, float maxT) const;
+  virtual Vector getNormalAt(const Vector &point, unsigned int primitive) const = 0;
+  virtual void getUVAt(const Vector &point, unsigned int primitive, float& u, float& v) const = 0;
+  //Objects made of other objects (groups, instances) take the material of the part hit
+  virtual const BaseMaterial* getMaterial(unsigned int) const { return material.get(); }
+  //Primitive indices are below this number
+  virtual unsigned int getPrimitiveCount() const { return 1; }
   virtual bool isFinite() const = 0;
-  virtual Vector getSample(RNG& rng) const = 0;
-  virtual void getSamples(RNG& rng, int s1, int s2, Vector* samples) const = 0;
+  virtual AABB getBoundingBox() const = 0;
+  //Maps a point of the unit square onto the surface, uniformly by area
+  virtual SurfaceSample getSample(float u1, float u2) const = 0;
   virtual float getInversePDF() const = 0;
-};
\ No newline at end of file
+  //Samples a point of the surface for a light sample taken at ref. pdf is per unit solid
+  //angle seen from ref, 0 if the sample cannot light ref. By default the area sample is converted,
+  //shapes which can do better only pick points visible from ref.
+  virtual SurfaceSample getSampleFrom(const Vector& ref, float u1, float u2, float& pdf) const;
+  //Density with which getSampleFrom(ref, ...) returns point
+  virtual float getPDFFrom(const Vector& ref, const Vector& point, unsigned int primitive) const;
+  //Cone (axis and cosine of its half angle) containing every normal of the surface,
+  //the whole sphere of directions unless a shape knows better
+  virtual void getNormalBounds(Vector& axis, float& cosTheta) const { axis = Vector(0, 0, 1); cosTheta = -1.0f; }
+};
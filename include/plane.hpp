@@ -5,7 +5,6 @@
 
 class BaseMaterial;
 class Ray;
-class RNG;
 
 class Plane : public Object
 {
@@ -17,16 +16,10 @@ public:
   Plane(const Vector& pt, const Vector& nor, std::shared_ptr<BaseMaterial> mat): Object(mat), point(pt), normal(nor) {}
 
   float intersect(const Ray& ray) const override;
-  Vector getNormalAt(const Vector&) const override;
-  void getUVAt(const Vector&, float& u, float& v) const override;
+  Vector getNormalAt(const Vector&, unsigned int) const override;
+  void getUVAt(const Vector&, unsigned int, float& u, float& v) const override;
+  AABB getBoundingBox() const override;
   bool isFinite() const override { return false; }
-  Vector getSample(RNG&) const override { return Vector(0,0,0); }
-  void getSamples(RNG&, int s1, int s2, Vector* samples) const override
-  {
-    for(int i = 0; i < s1*s2; ++i)
-    {
-      samples[i] = Vector(0,0,0);
-    }
-  }
+  SurfaceSample getSample(float, float) const override { return {Vector(0,0,0), 0}; }
   float getInversePDF() const override { return -1; }
 };
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "vector.hpp"
+
+class Film;
+
+//Step of the post-processing pipeline, transforms the linear RGB pixels of an HDR image
+class PostOperator
+{
+public:
+  virtual ~PostOperator() {}
+
+  //Gathers statistics of the whole image before apply, image is the input of the operator.
+  //threads is the number of threads the work can be split over.
+  virtual void prepare(const std::vector<Vector>& image, unsigned int threads) { (void)image; (void)threads; }
+  //Transforms count pixels in place, called from several threads at once
+  virtual void apply(Vector* pixels, size_t count) const = 0;
+};
+
+//Global Reinhard operator: luminance is scaled so the log-average maps to KEY, compressed
+//with L / (1 + L), and the color of every pixel keeps its chromaticity
+class ReinhardOperator : public PostOperator
+{
+private:
+  float m_scale;
+public:
+  float KEY;
+
+  ReinhardOperator(): m_scale(1.0f), KEY(0.18f) {}
+
+  void prepare(const std::vector<Vector>& image, unsigned int threads) override;
+  void apply(Vector* pixels, size_t count) const override;
+};
+
+//Turns HDR images into displayable ones by running operators in order and encoding the
+//result as 8-bit sRGB. The work is split into fixed blocks of pixels, so images do not
+//depend on the number of threads.
+class PostProcess
+{
+private:
+  std::vector<std::shared_ptr<PostOperator>> m_operators;
+public:
+  //THREADS = 0 uses every hardware thread
+  unsigned int THREADS;
+
+  PostProcess(): THREADS(0) {}
+
+  void addOperator(std::shared_ptr<PostOperator> op);
+
+  //Mean color of every pixel of the film
+  void resolve(const Film& film, std::vector<Vector>& image) const;
+  //Runs the operators over image
+  void apply(std::vector<Vector>& image) const;
+  //Prepares the operators on preview, which stands for the whole image (e.g. a smaller
+  //render of it), so applyPrepared can then transform the image a part at a time
+  void prepare(std::vector<Vector> preview) const;
+  //Runs the operators over image with the statistics of the last prepare
+  void applyPrepared(std::vector<Vector>& image) const;
+  //Writes 3 bytes per pixel to pixels, colors are clamped to [0, 1]
+  void encodeSRGB(const std::vector<Vector>& image, char* pixels) const;
+};
@@ -5,7 +5,6 @@
 
 class BaseMaterial;
 class Ray;
-class RNG;
 
 class Rectangle : public Object
 {
@@ -15,6 +14,9 @@ private:
   Vector m_bitangent;
   float m_invPDF;
   float m_sizeTangent, m_sizeBitangent;
+
+  //Whether light samples for ref are taken over the solid angle instead of the area
+  bool isSampledBySolidAngle(const Vector& ref) const;
 public:
   Vector point;
 
@@ -58,16 +60,22 @@ public:
     m_normal = m_tangent.cross(m_bitangent).normalize();
   }
 
+  const Vector& getNormal() const { return m_normal; }
+  const Vector& getTangent() const { return m_tangent; }
+  const Vector& getBitangent() const { return m_bitangent; }
   float getSizeTangent() const { return m_sizeTangent; }
   float getSizeBitangent() const { return m_sizeBitangent; }
   void setSizeTangent(float sizeTangent);
   void setSizeBitangent(float sizeBitangent);
 
   float intersect(const Ray& ray) const override;
-  Vector getNormalAt(const Vector&) const override;
-  void getUVAt(const Vector& point, float& u, float& v) const override;
+  Vector getNormalAt(const Vector&, unsigned int) const override;
+  void getUVAt(const Vector& point, unsigned int, float& u, float& v) const override;
+  AABB getBoundingBox() const override;
   bool isFinite() const override { return true; }
-  Vector getSample(RNG& rng) const override;
-  void getSamples(RNG& rng, int s1, int s2, Vector* samples) const override;
+  SurfaceSample getSample(float u1, float u2) const override;
   float getInversePDF() const override { return m_invPDF; }
+  SurfaceSample getSampleFrom(const Vector& ref, float u1, float u2, float& pdf) const override;
+  float getPDFFrom(const Vector& ref, const Vector& point, unsigned int primitive) const override;
+  void getNormalBounds(Vector& axis, float& cosTheta) const override { axis = m_normal; cosTheta = 1.0f; }
 };
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <chrono>
+#include <ctime>
+#include <map>
+#include <string>
+#include <vector>
+
+class Film;
+
+//Part of a frame rendered by one process: the pixels [x0, x1) x [y0, y1) of a width x height
+//image and the samples [firstSample, lastSample) of each of them, out of samples per pixel
+struct RenderJob
+{
+  unsigned int width, height, samples;
+  unsigned int x0, y0, x1, y1;
+  unsigned int firstSample, lastSample;
+
+  //A non-empty rectangle within the image and a non-empty range of its samples
+  bool hasValidRegion() const;
+  bool hasValidSamples() const;
+  bool isValid() const;
+};
+
+//Splits a frame into jobs of tileSize x tileSize pixels taking samplesPerJob samples of each
+//(0 - a job takes all samples of its pixels)
+std::vector<RenderJob> splitFrame(unsigned int width, unsigned int height, unsigned int samples, unsigned int tileSize, unsigned int samplesPerJob);
+//Jobs are stored as a single line of text
+bool saveJob(const RenderJob& job, const char* fileName);
+bool loadJob(const char* fileName, RenderJob& job);
+//Resets film to the image of the partial films (saved by jobs of one frame) and adds their
+//samples to it. False if a file cannot be loaded or belongs to another image.
+bool mergePartials(const std::vector<std::string>& fileNames, Film& film);
+
+//Jobs of a frame shared by processes through a directory, which may be on a file system shared
+//by several machines. Pending jobs are files in pending/, a worker claims one by renaming it
+//into running/ with its name appended, which only one process can do. The partial film of a
+//job is saved to done/, then the claim is deleted. Jobs which cannot be read are moved to
+//failed/. Workers keep their claims alive by touching them, claims of workers which died
+//are put back into pending/ after a timeout.
+class JobQueue
+{
+private:
+  struct ClaimState
+  {
+    time_t modified;
+    //When the coordinator last saw the modification time change, measured on its own clock
+    //as the file times may come from another machine
+    std::chrono::steady_clock::time_point seen;
+  };
+
+  std::string m_directory;
+  //Host name and process id, unique among all workers
+  std::string m_workerName;
+  std::map<std::string, ClaimState> m_claims;
+
+  std::vector<std::string> list(const std::string& subdirectory) const;
+  std::string getClaimPath(const std::string& partialFile) const;
+public:
+  //Seconds after which a claim which was not kept alive is released by releaseStale,
+  //workers keep theirs alive at a quarter of it
+  float CLAIM_TIMEOUT;
+
+  explicit JobQueue(const std::string& directory);
+
+  //Creates the directories and writes the jobs of a new frame to them
+  bool create(const std::vector<RenderJob>& jobs);
+  //Claims a pending job and returns the file its partial film is saved to,
+  //false when no job is pending
+  bool claim(RenderJob& job, std::string& partialFile);
+  //Deletes the claim on the job of partialFile once the film is saved
+  void complete(const std::string& partialFile);
+  //Marks the claim on the job of partialFile as alive, called while the job renders
+  void keepAlive(const std::string& partialFile);
+  //Puts the jobs claimed by a worker (e.g. one which crashed) back into pending/
+  //and returns their number
+  size_t release(const std::string& workerName);
+  //Puts the jobs whose claims were not kept alive for CLAIM_TIMEOUT back into pending/
+  //and returns their number, to be called regularly by the coordinator
+  size_t releaseStale();
+
+  //Number of jobs of the frame and the partial films saved so far
+  size_t getJobCount() const;
+  std::vector<std::string> getPartials() const;
+  size_t getPendingCount() const { return list("pending").size(); }
+  size_t getRunningCount() const { return list("running").size(); }
+  size_t getFailedCount() const { return list("failed").size(); }
+
+  const std::string& getWorkerName() const { return m_workerName; }
+  //Name of the worker with the given process id on this machine
+  static std::string getWorkerName(long processId);
+};
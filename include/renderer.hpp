@@ -3,28 +3,81 @@
 #include <vector>
 #include <memory>
 #include "core.hpp"
+#include "sampler.hpp"
 
 class Scene;
 class Object;
 class Camera;
+struct Tile;
+class ScratchArena;
+class Film;
+class LightTree;
+struct RenderJob;
 
 class Renderer
 {
 private:
   unsigned int m_width, m_height;
   float m_ar;
-  RNG m_rng;
+  //Growth of the ray footprint per unit distance, for texture filtering
+  float m_pixelSpread;
 
-  Vector sample(float x, float y, const Scene& scene, const std::vector<std::shared_ptr<Object>> &emissiveObjects, const Camera& camera, unsigned int s1, unsigned int s2);
+  float getTextureSpread(const Camera& camera, unsigned int samples) const;
+  Vector sample(float x, float y, const Scene& scene, const LightTree& lightTree, const Camera& camera, Sampler& sampler, ScratchArena& arena, unsigned int s1, unsigned int s2);
+  void renderTile(const Tile& tile, const Scene& scene, const LightTree& lightTree, const Camera& camera, Sampler& sampler, ScratchArena& arena, Film& film, unsigned int samples, const unsigned int* plan);
+  //Adds samples to the film using all threads, plan (if not null) holds the number
+  //of samples of every pixel of the film and overrides samples. The film may cover
+  //a part of the image only (see Film::setRegion).
+  void renderPass(const Scene& scene, const LightTree& lightTree, const Camera& camera, Film& film, unsigned int samples, const unsigned int* plan);
+  //Fills plan for the next progressive pass and returns the number of pixels to sample
+  size_t planPass(const Film& film, unsigned int samples, std::vector<unsigned int>& plan) const;
 public:
   unsigned int MC_SAMPLES, LIGHT_SAMPLES;
+  //THREADS = 0 uses every hardware thread
+  unsigned int THREADS, TILE_SIZE;
+  //Sample values depend only on SEED, the pixel and the sample index,
+  //images do not depend on threads or tiles. Splitting samples into other passes
+  //or jobs sums them in another order, which changes only the float rounding.
+  unsigned int SEED;
+  //Source of camera, light, BRDF and Russian roulette sample dimensions
+  SamplerType SAMPLER;
+  //Samples per pixel added by every pass of renderProgressive
+  unsigned int PASS_SAMPLES;
+  //Minimum time between two checkpoints in seconds
+  float CHECKPOINT_INTERVAL;
+  //Adaptive sampling (renderProgressive only): pixels whose estimated error drops below
+  //ADAPTIVE_THRESHOLD after MIN_SAMPLES stop receiving samples, 0 turns it off
+  float ADAPTIVE_THRESHOLD;
+  unsigned int MIN_SAMPLES;
+  //Stop renderProgressive after this many seconds or samples in the whole film, 0 = no limit
+  float TIME_BUDGET;
+  unsigned long long SAMPLE_BUDGET;
+  //renderStreaming: rows rendered and written at a time, and the largest number of pixels
+  //and the samples per pixel of the preview render tone mapping statistics come from.
+  //PREVIEW_SAMPLES = 0 uses MC_SAMPLES: the log-average luminance depends on the noise,
+  //a preview as noisy as the image gives the exposure a full-frame render would have.
+  unsigned int BAND_HEIGHT;
+  unsigned int PREVIEW_PIXELS, PREVIEW_SAMPLES;
 
-  Renderer(unsigned int width, unsigned int height): m_width(width), m_height(height)
+  Renderer(unsigned int width, unsigned int height): m_width(width), m_height(height), m_pixelSpread(0.0f)
   {
     m_ar = (float)width / height;
 
     MC_SAMPLES = 16;
     LIGHT_SAMPLES = 8;
+    THREADS = 0;
+    TILE_SIZE = 32;
+    SEED = 0;
+    SAMPLER = SamplerType::Sobol;
+    PASS_SAMPLES = 4;
+    CHECKPOINT_INTERVAL = 60.0f;
+    ADAPTIVE_THRESHOLD = 0.0f;
+    MIN_SAMPLES = 16;
+    TIME_BUDGET = 0.0f;
+    SAMPLE_BUDGET = 0;
+    BAND_HEIGHT = 64;
+    PREVIEW_PIXELS = 512 * 512;
+    PREVIEW_SAMPLES = 0;
   }
 
   void reset(unsigned int width, unsigned int height)
@@ -48,6 +101,34 @@ public:
     m_ar = (float)m_width/height;
   }
 
-  Vector traceRay(Ray &ray, const Scene &scene, const std::vector<std::shared_ptr<Object>> &areaLights, RNG &rng, unsigned int s1, unsigned int s2);
+  //Puts the finite emissive objects of the scene into lightTree, the lights traceRay samples.
+  //Objects without a material (groups and instances) are never sampled.
+  static void buildLightTree(const Scene& scene, LightTree& lightTree);
+  //sampler has to be started for the pixel sample, arena is reset on entry and holds
+  //the light samples of the path. Every shading point takes s1*s2 area light samples,
+  //each from one light picked by lightTree. The footprint of the ray, which textures are
+  //filtered over, grows by spread per unit of distance (0 - textures are not prefiltered).
+  Vector traceRay(Ray &ray, const Scene &scene, const LightTree& lightTree, Sampler& sampler, ScratchArena& arena, unsigned int s1, unsigned int s2, float spread = 0.0f);
   void render(const Scene& scene, const Camera& camera, char* &pixels);
+  //Renders MC_SAMPLES per pixel into film, which is reset first. The film holds the linear
+  //HDR image, for tonemap or Film::savePFM.
+  void render(const Scene& scene, const Camera& camera, Film& film);
+  //Renders passes of PASS_SAMPLES into film until every pixel has the given number of samples,
+  //has converged (with adaptive sampling) or a budget runs out.
+  //A film loaded from a checkpoint continues where it stopped. If checkpointFile is set,
+  //the film is saved to it every CHECKPOINT_INTERVAL seconds and after the last pass.
+  //False if the film is not a whole image of this size starting at sample 0 (e.g. a
+  //partial film of a job), nothing is rendered then.
+  bool renderProgressive(const Scene& scene, const Camera& camera, Film& film, unsigned int samples, const char* checkpointFile);
+  //Renders MC_SAMPLES per pixel in bands of BAND_HEIGHT rows, each tone mapped and written
+  //to the PPM fileName (and its HDR colors to the PFM hdrFileName, if set) as soon as it is
+  //done. Memory depends on the width of the image only. Tone mapping uses the statistics
+  //of a preview of at most PREVIEW_PIXELS pixels. False if a file could not be written.
+  bool renderStreaming(const Scene& scene, const Camera& camera, const char* fileName, const char* hdrFileName = nullptr);
+  //Renders the pixels and samples of job into film, which is reset to them. Merging the
+  //films of all jobs of a frame gives the image render would have produced with
+  //job.samples as MC_SAMPLES. False if the job is not a part of an image of this size.
+  bool renderJob(const Scene& scene, const Camera& camera, const RenderJob& job, Film& film);
+  //Reinhard tone mapping of the film to 8-bit sRGB (see PostProcess for other pipelines)
+  void tonemap(const Film& film, char* &pixels);
 };
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+
+#include "core.hpp"
+
+enum class SamplerType
+{
+  //Independent uniform numbers
+  Random,
+  //Owen-scrambled Sobol points, shuffled independently for every pair of dimensions
+  Sobol,
+  //Halton sequence with digits scrambled per pixel and dimension
+  Halton,
+  //Sobol points shared by all pixels, shifted by a blue noise mask, so the remaining
+  //error looks like high frequency noise
+  BlueNoise
+};
+
+//Hands out the random numbers of one sample of one pixel. Every call consumes the
+//next dimension(s), a path asks for them in the same order in every sample, so
+//samples of a pixel are well distributed in each dimension.
+class Sampler
+{
+protected:
+  uint64_t m_seed;
+  uint64_t m_pixelSeed;
+  unsigned int m_x, m_y;
+  uint32_t m_index;
+  uint32_t m_dimension;
+
+  //64 random bits unique to the current pixel and dimension, the same for all its samples
+  uint64_t pixelDimensionSeed() const { return RNG::mix(m_pixelSeed ^ m_dimension); }
+public:
+  Sampler(uint64_t seed): m_seed(seed), m_pixelSeed(0), m_x(0), m_y(0), m_index(0), m_dimension(0) {}
+  virtual ~Sampler() {}
+
+  virtual void startSample(unsigned int x, unsigned int y, uint32_t index)
+  {
+    if(x != m_x || y != m_y || m_pixelSeed == 0)
+      m_pixelSeed = RNG::mix(m_seed ^ RNG::mix(((uint64_t)y << 32) | x));
+    m_x = x;
+    m_y = y;
+    m_index = index;
+    m_dimension = 0;
+  }
+
+  virtual float get1D() = 0;
+  virtual void get2D(float& u1, float& u2) = 0;
+  //count points of one pair of dimensions (u holds 2*count floats). The points come from
+  //an Owen-scrambled (0,2)-sequence, every power of two prefix is stratified.
+  virtual void get2DArray(unsigned int count, float* u);
+
+  static std::unique_ptr<Sampler> create(SamplerType type, uint64_t seed);
+  static const char* getName(SamplerType type);
+};
+
+class RandomSampler : public Sampler
+{
+private:
+  RNG m_rng;
+public:
+  RandomSampler(uint64_t seed): Sampler(seed) {}
+
+  void startSample(unsigned int x, unsigned int y, uint32_t index) override;
+  float get1D() override;
+  void get2D(float& u1, float& u2) override;
+};
+
+class SobolSampler : public Sampler
+{
+public:
+  SobolSampler(uint64_t seed): Sampler(seed) {}
+
+  float get1D() override;
+  void get2D(float& u1, float& u2) override;
+};
+
+class HaltonSampler : public Sampler
+{
+public:
+  HaltonSampler(uint64_t seed): Sampler(seed) {}
+
+  float get1D() override;
+  void get2D(float& u1, float& u2) override;
+};
+
+class BlueNoiseSampler : public Sampler
+{
+private:
+  //Per pixel toroidal shift of the given dimension
+  float getShift(uint32_t dimension) const;
+public:
+  BlueNoiseSampler(uint64_t seed): Sampler(seed) {}
+
+  float get1D() override;
+  void get2D(float& u1, float& u2) override;
+};
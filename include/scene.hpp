@@ -8,6 +8,16 @@ class Light;
 class Ray;
 
 #include "environmentMap.hpp"
+#include "bvh.hpp"
+#include "compiledScene.hpp"
+
+enum class Acceleration
+{
+  //Bounding volume hierarchy over the objects, scales to large scenes
+  BVH,
+  //Flat arrays of primitives tested with vector instructions, for a few dozen objects
+  Compiled
+};
 
 class Scene
 {
@@ -15,21 +25,51 @@ private:
   std::vector<std::shared_ptr<Object>> m_objects;
   std::vector<std::shared_ptr<Light>> m_lights;
   EnvironmentMap m_envMap;
+
+  //Filled by build(): finite objects in BVH leaf order and unbounded ones tested on every ray,
+  //both point into m_objects
+  BVH m_bvh;
+  //Keeps nodes the BVH was built from elsewhere alive
+  std::shared_ptr<const void> m_bvhOwner;
+  std::vector<const Object*> m_bounded;
+  std::vector<const Object*> m_unbounded;
+  CompiledScene m_compiled;
+  Acceleration m_acceleration;
+  bool m_built;
+
+  const Object* intersectLinear(const Ray& ray, float* closestT, unsigned int* primitive) const;
+  bool occlusionTestLinear(const Ray& ray, float maxT) const;
 public:
-  Scene(): m_objects(std::vector<std::shared_ptr<Object>>()), m_lights(std::vector<std::shared_ptr<Light>>()), m_envMap(EnvironmentMap()) {}
-  Scene(const EnvironmentMap& envMap): m_objects(std::vector<std::shared_ptr<Object>>()), m_lights(std::vector<std::shared_ptr<Light>>())
+  Scene(): m_objects(std::vector<std::shared_ptr<Object>>()), m_lights(std::vector<std::shared_ptr<Light>>()), m_envMap(EnvironmentMap()), m_acceleration(Acceleration::BVH), m_built(false) {}
+  Scene(const EnvironmentMap& envMap): m_objects(std::vector<std::shared_ptr<Object>>()), m_lights(std::vector<std::shared_ptr<Light>>()), m_acceleration(Acceleration::BVH), m_built(false)
   {
     m_envMap = envMap;
   }
 
-  void addObject(std::shared_ptr<Object> object) { m_objects.push_back(object); }
+  void addObject(std::shared_ptr<Object> object) { m_objects.push_back(object); m_built = false; }
   void addLight(std::shared_ptr<Light> light) { m_lights.push_back(light); }
   void setEnvironmentMap(const EnvironmentMap& envMap) { m_envMap = envMap; }
 
-  std::shared_ptr<Object> intersect(const Ray& ray, float* closestT) const;
+  //Builds the acceleration structure, has to be called again after adding objects.
+  //Until then every ray is tested against every object.
+  void build(Acceleration acceleration = Acceleration::BVH);
+  //Builds the BVH acceleration from nodes built earlier over the bounds of the finite
+  //objects, in the order they were added. indices holds the position among those of the
+  //object every leaf primitive stands for (BVH::getIndices). The nodes are not copied,
+  //owner keeps them alive. False, leaving the scene unbuilt, if they do not fit the objects.
+  bool build(const BVHNode* nodes, size_t nodeCount, const unsigned int* indices, size_t indexCount, std::shared_ptr<const void> owner);
+  bool isBuilt() const { return m_built; }
+  Acceleration getAcceleration() const { return m_acceleration; }
+
+  //primitive (may be null) receives the index of the hit primitive within the object.
+  //The returned object is owned by the scene.
+  const Object* intersect(const Ray& ray, float* closestT, unsigned int* primitive) const;
   bool occlusionTest(const Ray& ray, float maxT) const;
 
-  std::vector<std::shared_ptr<Object>> getObjects() const { return m_objects; }
-  std::vector<std::shared_ptr<Light>> getLights() const { return m_lights; }
+  const std::vector<std::shared_ptr<Object>>& getObjects() const { return m_objects; }
+  const std::vector<std::shared_ptr<Light>>& getLights() const { return m_lights; }
   const EnvironmentMap& getEnvironmentMap() const { return m_envMap; }
+  //Hierarchy over the finite objects, empty unless built with Acceleration::BVH
+  const BVH& getBVH() const { return m_bvh; }
 };
+
@@ -0,0 +1,18 @@
+#pragma once
+
+class Scene;
+class Camera;
+
+//Compiled scenes are single binary files holding the camera, environment, texture paths,
+//materials, objects and lights as flat records. They also hold the geometry of every mesh
+//together with its hierarchy, and the hierarchy over the objects. Records only refer to
+//each other by index or file offset, so the file is mapped and used in place: meshes read
+//vertices and nodes straight from the mapping, which they keep alive.
+
+//Reads the text description in textFile (see README), loads its meshes, builds every
+//hierarchy and writes the result to binaryFile. Mesh and texture paths are relative to
+//textFile.
+bool compileScene(const char* textFile, const char* binaryFile);
+//Adds the objects and lights of a compiled scene to scene, sets its environment, builds it
+//from the stored hierarchy and sets camera. False if the file is not a valid compiled scene.
+bool loadCompiledScene(const char* fileName, Scene& scene, Camera& camera);
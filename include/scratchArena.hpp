@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <vector>
+
+//Bump allocator for short-lived per-thread buffers. Memory handed out stays valid
+//until reset(). After the first few resets the arena holds a single block large
+//enough for the biggest request pattern seen and stops touching the heap.
+//Only meant for trivially destructible types, destructors are never run.
+class ScratchArena
+{
+private:
+  std::unique_ptr<char[]> m_block;
+  size_t m_capacity, m_used;
+  //Blocks which overflowed since the last reset, merged into one by reset()
+  std::vector<std::unique_ptr<char[]>> m_overflow;
+  size_t m_overflowSize;
+
+  void* allocateOverflow(size_t bytes);
+public:
+  ScratchArena(size_t capacity = 4096);
+  ScratchArena(const ScratchArena&) = delete;
+  ScratchArena& operator=(const ScratchArena&) = delete;
+  ScratchArena(ScratchArena&&) = default;
+  ScratchArena& operator=(ScratchArena&&) = default;
+
+  template <typename T>
+  T* allocate(size_t count)
+  {
+    const size_t align = alignof(T) > alignof(std::max_align_t) ? alignof(T) : alignof(std::max_align_t);
+    size_t offset = (m_used + align - 1) & ~(align - 1);
+    size_t bytes = count * sizeof(T);
+    void* memory;
+    if(offset + bytes <= m_capacity)
+    {
+      memory = m_block.get() + offset;
+      m_used = offset + bytes;
+    }
+    else
+      memory = allocateOverflow(bytes);
+    T* items = static_cast<T*>(memory);
+    for(size_t i = 0; i < count; ++i)
+      new (items + i) T();
+    return items;
+  }
+
+  void reset();
+  size_t getCapacity() const { return m_capacity; }
+};
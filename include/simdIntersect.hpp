@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+
+class Ray;
+
+//Structure-of-arrays views of primitives of one type, every array holds count floats.
+//Kernels test one ray against all of them at once.
+struct SphereBatch
+{
+  const float *centerX, *centerY, *centerZ;
+  const float *radius;
+  size_t count;
+};
+
+struct RectangleBatch
+{
+  const float *pointX, *pointY, *pointZ;
+  const float *normalX, *normalY, *normalZ;
+  const float *tangentX, *tangentY, *tangentZ;
+  const float *bitangentX, *bitangentY, *bitangentZ;
+  const float *sizeTangent, *sizeBitangent;
+  size_t count;
+};
+
+struct EllipseBatch
+{
+  const float *centerX, *centerY, *centerZ;
+  const float *normalX, *normalY, *normalZ;
+  const float *axisTX, *axisTY, *axisTZ;
+  const float *axisBX, *axisBY, *axisBZ;
+  const float *semiTangent, *semiBitangent;
+  size_t count;
+};
+
+enum class SimdLevel
+{
+  Scalar,
+  SSE,
+  AVX2
+};
+
+//Widest instruction set supported by the CPU
+SimdLevel getSupportedSimdLevel();
+//Instruction set of the kernels in use, the supported one unless setSimdLevel chose another
+SimdLevel getActiveSimdLevel();
+//Forces narrower kernels (a level the CPU lacks falls back to the best supported one).
+//The kernels are shared without synchronization, so this must only be called while
+//nothing is intersecting, i.e. not during a render.
+void setSimdLevel(SimdLevel level);
+const char* getSimdLevelName(SimdLevel level);
+
+//Index of the closest primitive hit in (0, tMax) or -1, tMax is set to its distance.
+//Results match Sphere/Rectangle/Ellipse::intersect exactly, on equal distances
+//the lower index wins.
+int intersectSpheres(const Ray& ray, const SphereBatch& batch, float& tMax);
+int intersectRectangles(const Ray& ray, const RectangleBatch& batch, float& tMax);
+int intersectEllipses(const Ray& ray, const EllipseBatch& batch, float& tMax);
+
+//True if any primitive is hit in (0, maxT), a negative maxT means no limit
+bool occludedSpheres(const Ray& ray, const SphereBatch& batch, float maxT);
+bool occludedRectangles(const Ray& ray, const RectangleBatch& batch, float maxT);
+bool occludedEllipses(const Ray& ray, const EllipseBatch& batch, float maxT);
@@ -0,0 +1,227 @@
+#pragma once
+
+#include "simdIntersect.hpp"
+#include "core.hpp"
+
+//Shared by the scalar, SSE and AVX2 code paths. The lane type F wraps one vector
+//register and provides arithmetic, ordered comparisons returning masks, & and |,
+//select(mask, a, b), sqrt, min, moveMask, load and store.
+//Every kernel evaluates the same operations in the same order as the scalar
+//Object::intersect implementations, so all paths return identical distances.
+//The scalar helpers are static: an inline copy compiled with -mavx2 must never be
+//picked by the linker for the other translation units.
+
+static inline float intersectSphereAt(const Ray& ray, const SphereBatch& b, size_t i)
+{
+  float cox = ray.origin.x - b.centerX[i];
+  float coy = ray.origin.y - b.centerY[i];
+  float coz = ray.origin.z - b.centerZ[i];
+  float bb = 2.0f * (ray.direction.x * cox + ray.direction.y * coy + ray.direction.z * coz);
+  float c = (cox * cox + coy * coy + coz * coz) - b.radius[i] * b.radius[i];
+  float delta = bb*bb - 4.0f*c;
+  if(delta < 0.0f) return -1.0f;
+
+  delta = sqrtf(delta);
+  float t1 = (-bb - delta) * 0.5f;
+  float t2 = (-bb + delta) * 0.5f;
+  return (t1 < t2 ? t1 : t2);
+}
+
+static inline float intersectRectangleAt(const Ray& ray, const RectangleBatch& b, size_t i)
+{
+  float don = ray.direction.x * b.normalX[i] + ray.direction.y * b.normalY[i] + ray.direction.z * b.normalZ[i];
+  if(don > -0.00001f && don < 0.00001f) return -1;
+  float ox = ray.origin.x - b.pointX[i];
+  float oy = ray.origin.y - b.pointY[i];
+  float oz = ray.origin.z - b.pointZ[i];
+  float t = -(ox * b.normalX[i] + oy * b.normalY[i] + oz * b.normalZ[i]) / don;
+  if(t < 0.0f) return -1;
+
+  float rx = (ray.origin.x + ray.direction.x * t) - b.pointX[i];
+  float ry = (ray.origin.y + ray.direction.y * t) - b.pointY[i];
+  float rz = (ray.origin.z + ray.direction.z * t) - b.pointZ[i];
+  float distT = rx * b.tangentX[i] + ry * b.tangentY[i] + rz * b.tangentZ[i];
+  float distB = rx * b.bitangentX[i] + ry * b.bitangentY[i] + rz * b.bitangentZ[i];
+
+  if(distT < 0.0f || distT > b.sizeTangent[i] || distB < 0.0f || distB > b.sizeBitangent[i]) return -1;
+
+  return t;
+}
+
+static inline float intersectEllipseAt(const Ray& ray, const EllipseBatch& b, size_t i)
+{
+  float don = ray.direction.x * b.normalX[i] + ray.direction.y * b.normalY[i] + ray.direction.z * b.normalZ[i];
+  if(don > -0.00001f && don < 0.00001f) return -1;
+  float ox = ray.origin.x - b.centerX[i];
+  float oy = ray.origin.y - b.centerY[i];
+  float oz = ray.origin.z - b.centerZ[i];
+  float t = -(ox * b.normalX[i] + oy * b.normalY[i] + oz * b.normalZ[i]) / don;
+  if(t < 0.0f) return -1;
+
+  float rx = (ray.origin.x + ray.direction.x * t) - b.centerX[i];
+  float ry = (ray.origin.y + ray.direction.y * t) - b.centerY[i];
+  float rz = (ray.origin.z + ray.direction.z * t) - b.centerZ[i];
+  float distT = rx * b.axisTX[i] + ry * b.axisTY[i] + rz * b.axisTZ[i];
+  float distB = rx * b.axisBX[i] + ry * b.axisBY[i] + rz * b.axisBZ[i];
+  distT *= (distT / (b.semiTangent[i] * b.semiTangent[i]));
+  distB *= (distB / (b.semiBitangent[i] * b.semiBitangent[i]));
+
+  if(distT + distB > 1.0f) return -1;
+
+  return t;
+}
+
+template <typename F>
+struct LaneRay
+{
+  F ox, oy, oz;
+  F dx, dy, dz;
+
+  LaneRay(const Ray& ray): ox(ray.origin.x), oy(ray.origin.y), oz(ray.origin.z),
+                           dx(ray.direction.x), dy(ray.direction.y), dz(ray.direction.z) {}
+};
+
+template <typename F>
+inline F sphereLanes(const LaneRay<F>& ray, const SphereBatch& b, size_t i)
+{
+  F cox = ray.ox - F::load(b.centerX + i);
+  F coy = ray.oy - F::load(b.centerY + i);
+  F coz = ray.oz - F::load(b.centerZ + i);
+  F r = F::load(b.radius + i);
+  F bb = F(2.0f) * (ray.dx * cox + ray.dy * coy + ray.dz * coz);
+  F c = (cox * cox + coy * coy + coz * coz) - r * r;
+  F delta = bb*bb - F(4.0f)*c;
+  F miss = delta < F(0.0f);
+
+  delta = sqrt(delta);
+  F t1 = (-bb - delta) * F(0.5f);
+  F t2 = (-bb + delta) * F(0.5f);
+  return select(miss, F(-1.0f), min(t1, t2));
+}
+
+template <typename F>
+inline F rectangleLanes(const LaneRay<F>& ray, const RectangleBatch& b, size_t i)
+{
+  F nx = F::load(b.normalX + i), ny = F::load(b.normalY + i), nz = F::load(b.normalZ + i);
+  F px = F::load(b.pointX + i), py = F::load(b.pointY + i), pz = F::load(b.pointZ + i);
+  F don = ray.dx * nx + ray.dy * ny + ray.dz * nz;
+  F miss = (don > F(-0.00001f)) & (don < F(0.00001f));
+  F t = -((ray.ox - px) * nx + (ray.oy - py) * ny + (ray.oz - pz) * nz) / don;
+  miss = miss | (t < F(0.0f));
+
+  F rx = (ray.ox + ray.dx * t) - px;
+  F ry = (ray.oy + ray.dy * t) - py;
+  F rz = (ray.oz + ray.dz * t) - pz;
+  F distT = rx * F::load(b.tangentX + i) + ry * F::load(b.tangentY + i) + rz * F::load(b.tangentZ + i);
+  F distB = rx * F::load(b.bitangentX + i) + ry * F::load(b.bitangentY + i) + rz * F::load(b.bitangentZ + i);
+  miss = miss | (distT < F(0.0f)) | (distT > F::load(b.sizeTangent + i)) | (distB < F(0.0f)) | (distB > F::load(b.sizeBitangent + i));
+
+  return select(miss, F(-1.0f), t);
+}
+
+template <typename F>
+inline F ellipseLanes(const LaneRay<F>& ray, const EllipseBatch& b, size_t i)
+{
+  F nx = F::load(b.normalX + i), ny = F::load(b.normalY + i), nz = F::load(b.normalZ + i);
+  F cx = F::load(b.centerX + i), cy = F::load(b.centerY + i), cz = F::load(b.centerZ + i);
+  F don = ray.dx * nx + ray.dy * ny + ray.dz * nz;
+  F miss = (don > F(-0.00001f)) & (don < F(0.00001f));
+  F t = -((ray.ox - cx) * nx + (ray.oy - cy) * ny + (ray.oz - cz) * nz) / don;
+  miss = miss | (t < F(0.0f));
+
+  F rx = (ray.ox + ray.dx * t) - cx;
+  F ry = (ray.oy + ray.dy * t) - cy;
+  F rz = (ray.oz + ray.dz * t) - cz;
+  F distT = rx * F::load(b.axisTX + i) + ry * F::load(b.axisTY + i) + rz * F::load(b.axisTZ + i);
+  F distB = rx * F::load(b.axisBX + i) + ry * F::load(b.axisBY + i) + rz * F::load(b.axisBZ + i);
+  F semiT = F::load(b.semiTangent + i);
+  F semiB = F::load(b.semiBitangent + i);
+  distT = distT * (distT / (semiT * semiT));
+  distB = distB * (distB / (semiB * semiB));
+  miss = miss | ((distT + distB) > F(1.0f));
+
+  return select(miss, F(-1.0f), t);
+}
+
+//Keeps the best distance and index per lane and reduces them at the end,
+//the remainder which does not fill a register goes through the scalar kernel
+template <typename F, typename Batch, typename LaneKernel, typename ScalarKernel>
+int closestLanes(const Ray& ray, const Batch& batch, float& tMax, LaneKernel lanes, ScalarKernel scalar)
+{
+  LaneRay<F> laneRay(ray);
+  F best(tMax), bestIndex(-1.0f), index = F::indices();
+  size_t i = 0;
+  for(; i + F::WIDTH <= batch.count; i += F::WIDTH)
+  {
+    F t = lanes(laneRay, batch, i);
+    F closer = (t > F(0.0f)) & (t < best);
+    if(moveMask(closer))
+    {
+      best = select(closer, t, best);
+      bestIndex = select(closer, index, bestIndex);
+    }
+    index = index + F((float)F::WIDTH);
+  }
+
+  float laneT[F::WIDTH], laneIndex[F::WIDTH];
+  best.store(laneT);
+  bestIndex.store(laneIndex);
+  int hit = -1;
+  for(int l = 0; l < F::WIDTH; ++l)
+  {
+    if(laneIndex[l] < 0.0f) continue;
+    int idx = (int)laneIndex[l];
+    if(hit < 0 || laneT[l] < tMax || (laneT[l] == tMax && idx < hit))
+    {
+      tMax = laneT[l];
+      hit = idx;
+    }
+  }
+
+  for(; i < batch.count; ++i)
+  {
+    float t = scalar(ray, batch, i);
+    if(t > 0.0f && t < tMax)
+    {
+      tMax = t;
+      hit = i;
+    }
+  }
+  return hit;
+}
+
+template <typename F, typename Batch, typename LaneKernel, typename ScalarKernel>
+bool occludedLanes(const Ray& ray, const Batch& batch, float maxT, LaneKernel lanes, ScalarKernel scalar)
+{
+  LaneRay<F> laneRay(ray);
+  F limit(maxT);
+  F unlimited = limit < F(0.0f);
+  size_t i = 0;
+  for(; i + F::WIDTH <= batch.count; i += F::WIDTH)
+  {
+    F t = lanes(laneRay, batch, i);
+    if(moveMask((t > F(0.0f)) & ((t < limit) | unlimited))) return true;
+  }
+
+  for(; i < batch.count; ++i)
+  {
+    float t = scalar(ray, batch, i);
+    if(t > 0.0f && (t < maxT || maxT < 0.0f)) return true;
+  }
+  return false;
+}
+
+//Entry points of the vectorized translation units
+int intersectSpheresSSE(const Ray& ray, const SphereBatch& batch, float& tMax);
+int intersectRectanglesSSE(const Ray& ray, const RectangleBatch& batch, float& tMax);
+int intersectEllipsesSSE(const Ray& ray, const EllipseBatch& batch, float& tMax);
+bool occludedSpheresSSE(const Ray& ray, const SphereBatch& batch, float maxT);
+bool occludedRectanglesSSE(const Ray& ray, const RectangleBatch& batch, float maxT);
+bool occludedEllipsesSSE(const Ray& ray, const EllipseBatch& batch, float maxT);
+
+int intersectSpheresAVX2(const Ray& ray, const SphereBatch& batch, float& tMax);
+int intersectRectanglesAVX2(const Ray& ray, const RectangleBatch& batch, float& tMax);
+int intersectEllipsesAVX2(const Ray& ray, const EllipseBatch& batch, float& tMax);
+bool occludedSpheresAVX2(const Ray& ray, const SphereBatch& batch, float maxT);
+bool occludedRectanglesAVX2(const Ray& ray, const RectangleBatch& batch, float maxT);
+bool occludedEllipsesAVX2(const Ray& ray, const EllipseBatch& batch, float maxT);
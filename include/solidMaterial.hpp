@@ -19,7 +19,7 @@ public:
 
   ~SolidMaterial();
 
-  Vector getColor(float, float) const override;
+  Vector getColor(float, float, float = 0.0f) const override;
   Vector getEmittance(float, float) const override;
   bool isEmissive() const override;
   BRDF* getBRDF() const override;
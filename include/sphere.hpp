@@ -18,10 +18,12 @@ public:
   void setRadius(float radius);
 
   float intersect(const Ray& ray) const override;
-  Vector getNormalAt(const Vector& point) const override;
-  void getUVAt(const Vector& point, float& u, float& v) const override;
+  Vector getNormalAt(const Vector& point, unsigned int) const override;
+  void getUVAt(const Vector& point, unsigned int, float& u, float& v) const override;
+  AABB getBoundingBox() const override;
   bool isFinite() const override { return true; }
-  Vector getSample(RNG& rng) const override;
-  void getSamples(RNG& rng, int s1, int s2, Vector* samples) const override;
+  SurfaceSample getSample(float u1, float u2) const override;
   float getInversePDF() const override { return m_invPDF; }
+  SurfaceSample getSampleFrom(const Vector& ref, float u1, float u2, float& pdf) const override;
+  float getPDFFrom(const Vector& ref, const Vector& point, unsigned int primitive) const override;
 };
@@ -1,29 +1,37 @@
 #pragma once
 
+#include <memory>
+
 class Vector;
+class TextureData;
 
+//Handle to shared texture data together with how it is addressed. Copies share the texels,
+//so the same image can be used flipped and unflipped without being stored twice.
 class Texture
 {
 private:
-  int m_width;
-  int m_height;
-  int m_len;
-  float* m_data;
-  bool m_valid;
+  std::shared_ptr<const TextureData> m_data;
   bool m_flip_v;
 public:
-  Texture(const Texture& texture);
+  Texture(std::shared_ptr<const TextureData> data, bool flip_v = false);
   Texture(int width, int height, const float *data, bool flip_v = false);
   Texture(const Vector& color, bool flip_v = false);
+  //Loads the file on its own, use TextureRegistry to share files between textures
   Texture(const char* fileName, bool flip_v = false);
-  
-  ~Texture();
 
   void setVFlipping(bool flipV);
   bool flipV() const;
   bool isValid() const;
-  Vector sample(float u, float v) const;
+  int getWidth() const;
+  int getHeight() const;
+  int getLevels() const;
+  const std::shared_ptr<const TextureData>& getData() const { return m_data; }
 
-  Texture& operator=(const Texture& other);
+  //Nearest texel of the full resolution level
+  Vector sample(float u, float v) const;
+  //Bilinear lookup in one level of the pyramid, 0 is the full resolution
+  Vector sampleBilinear(float u, float v, int level = 0) const;
+  //Trilinear lookup for a footprint which is the given width in texture coordinates,
+  //0 gives a bilinear lookup at full resolution
+  Vector sampleTrilinear(float u, float v, float footprint) const;
 };
-
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+class Vector;
+
+//Immutable RGB texels of a texture with a mip pyramid built at creation. Shared by every
+//Texture looking it up, so addressing such as v flipping belongs to the lookup, not the data.
+//Texture coordinates wrap around.
+class TextureData
+{
+public:
+  //LDR images keep their 8-bit sRGB texels, decoded through a table on lookup.
+  //Float data is stored as half floats, clamped to the largest half (65504).
+  enum class Format
+  {
+    SRGB8,
+    Half
+  };
+private:
+  //Texels of every level are stored in TILE_SIZE x TILE_SIZE tiles (row by row inside a tile,
+  //tiles row by row), so lookups of neighbouring pixels touch a few tiles instead of many rows
+  static const int TILE_SHIFT = 3;
+  static const int TILE_SIZE = 1 << TILE_SHIFT;
+
+  struct Level
+  {
+    int width, height;
+    int tilesX;
+    //Index of the first channel of the level in the texels
+    size_t offset;
+  };
+
+  int m_width;
+  int m_height;
+  Format m_format;
+  std::vector<Level> m_levels;
+  //Only the vector of the format is used
+  std::vector<uint8_t> m_srgb;
+  std::vector<uint16_t> m_half;
+
+  //Computes the level sizes and returns the number of channels of all levels
+  size_t layout();
+  //Builds the pyramid from row-major RGB data of the full resolution level
+  void build(const float* data);
+  void build(const uint8_t* srgb);
+  //Stores row-major linear RGB data of a level in the texels of the format
+  void store(const Level& level, const float* data);
+  //Stores the levels below the full resolution one, filtered from its row-major RGB data
+  template<typename T>
+  void storeMips(const T* data);
+  size_t getTexelIndex(const Level& level, int x, int y) const
+  {
+    int tile = (y >> TILE_SHIFT) * level.tilesX + (x >> TILE_SHIFT);
+    int inTile = ((y & (TILE_SIZE - 1)) << TILE_SHIFT) | (x & (TILE_SIZE - 1));
+    return level.offset + 3 * (tile * TILE_SIZE * TILE_SIZE + inTile);
+  }
+  template<typename T>
+  Vector nearest(const T* texels, const Level& level, float u, float v) const;
+  template<typename T>
+  Vector bilinear(const T* texels, const Level& level, float u, float v) const;
+  Vector bilinear(const Level& level, float u, float v) const;
+public:
+  TextureData(int width, int height, const float *data);
+  //Row-major 8-bit sRGB data, as stored in PPM files
+  TextureData(int width, int height, const uint8_t *srgb);
+  TextureData(const Vector& color);
+
+  //Loads a PPM (sRGB) or PFM (linear) file, nullptr when it cannot be read
+  static std::shared_ptr<const TextureData> load(const char* fileName);
+
+  int getWidth() const { return m_width; }
+  int getHeight() const { return m_height; }
+  int getLevels() const { return m_levels.size(); }
+  Format getFormat() const { return m_format; }
+  //Bytes taken by the texels of all levels
+  size_t getMemorySize() const { return m_srgb.size() * sizeof(uint8_t) + m_half.size() * sizeof(uint16_t); }
+
+  Vector sample(float u, float v) const;
+  Vector sampleBilinear(float u, float v, int level) const;
+  Vector sampleTrilinear(float u, float v, float footprint) const;
+};
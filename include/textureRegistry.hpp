@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "texture.hpp"
+
+class TextureData;
+
+//Loads every image file once and hands out textures sharing its texels. Files are keyed on
+//the path as given, so "a/../b.ppm" and "b.ppm" are loaded separately.
+class TextureRegistry
+{
+private:
+  std::unordered_map<std::string, std::shared_ptr<const TextureData>> m_textures;
+  mutable std::mutex m_mutex;
+public:
+  //Texture of the file, loaded on the first request. A file which cannot be loaded gives an
+  //invalid texture and is reported once.
+  Texture get(const std::string& fileName, bool flip_v = false);
+
+  //Number of files requested so far
+  size_t size() const;
+  //Bytes taken by the texels of all loaded files
+  size_t getMemorySize() const;
+  //Forgets the files, textures already handed out keep their data
+  void clear();
+};
@@ -28,7 +28,7 @@ public:
   float getEmittanceIntensity() const;
   void setEmittanceIntensity(float emitIntensity);
 
-  Vector getColor(float u, float v) const override;
+  Vector getColor(float u, float v, float footprint = 0.0f) const override;
   Vector getEmittance(float u, float v) const override;
   bool isEmissive() const override;
   BRDF* getBRDF() const override;
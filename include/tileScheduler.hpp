@@ -0,0 +1,40 @@
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <memory>
+#include <vector>
+
+struct Tile
+{
+  unsigned int x0, y0;
+  unsigned int x1, y1;
+};
+
+//Splits the image into tiles and hands them out to worker threads.
+//Each worker owns a queue of neighbouring tiles and pops from its front;
+//once it runs dry it steals from the back of the other workers' queues.
+class TileScheduler
+{
+private:
+  struct WorkQueue
+  {
+    std::mutex mutex;
+    std::deque<Tile> tiles;
+  };
+
+  std::vector<std::unique_ptr<WorkQueue>> m_queues;
+  size_t m_tileCount;
+
+  bool pop(unsigned int worker, Tile& tile);
+  bool steal(unsigned int victim, Tile& tile);
+public:
+  TileScheduler(unsigned int width, unsigned int height, unsigned int tileSize, unsigned int workers);
+
+  bool next(unsigned int worker, Tile& tile);
+
+  size_t getTileCount() const { return m_tileCount; }
+  unsigned int getWorkerCount() const { return m_queues.size(); }
+
+  static unsigned int getDefaultThreadCount();
+};
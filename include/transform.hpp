@@ -0,0 +1,35 @@
+#pragma once
+
+#include "vector.hpp"
+#include "aabb.hpp"
+
+//Affine transformation: points are mapped to matrix * point + offset
+class Transform
+{
+private:
+  float m_matrix[3][3];
+  Vector m_offset;
+public:
+  //Identity
+  Transform();
+  Transform(const Vector& row0, const Vector& row1, const Vector& row2, const Vector& offset);
+
+  static Transform translation(const Vector& offset);
+  static Transform scaling(const Vector& factors);
+  //Counterclockwise around axis, looking against it
+  static Transform rotation(const Vector& axis, float degrees);
+
+  //Applies other first and then this
+  Transform operator*(const Transform& other) const;
+  //The identity for transformations which cannot be inverted
+  Transform inverse() const;
+  float getDeterminant() const;
+
+  Vector applyToPoint(const Vector& point) const;
+  Vector applyToVector(const Vector& vector) const;
+  //Normals are transformed by the inverse transpose: called on the inverse of the transformation
+  //of the surface, this multiplies by the transposed matrix. The result is not normalized.
+  Vector applyToNormal(const Vector& normal) const;
+  //Box around the transformed corners of box
+  AABB applyToBox(const AABB& box) const;
+};
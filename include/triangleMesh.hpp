@@ -0,0 +1,88 @@
+#pragma once
+
+#include <vector>
+
+#include "object.hpp"
+#include "vector.hpp"
+#include "bvh.hpp"
+
+class BaseMaterial;
+class Ray;
+
+//Indexed triangle list, every vertex has a position and optionally a normal and
+//texture coordinates. normals and uvs are either empty or hold one entry
+//(two floats for uvs) per position.
+struct MeshData
+{
+  std::vector<Vector> positions;
+  std::vector<Vector> normals;
+  std::vector<float> uvs;
+  std::vector<unsigned int> indices;
+};
+
+//Geometry of a mesh kept elsewhere, e.g. in a mapped scene file. Triangles are stored in
+//the leaf order of nodes, areaCDF holds the running sum of their areas. normals and uvs
+//may be null.
+struct MeshView
+{
+  const Vector* positions;
+  const Vector* normals;
+  const float* uvs;
+  const unsigned int* indices;
+  const float* areaCDF;
+  size_t vertexCount, triangleCount;
+  const BVHNode* nodes;
+  size_t nodeCount;
+};
+
+//Whole mesh is a single object, triangles are its primitives and are kept in
+//shared vertex buffers instead of being objects of their own
+class TriangleMesh : public Object
+{
+private:
+  //Geometry the mesh owns, empty when it uses data kept alive by m_owner
+  MeshData m_data;
+  //Running sum of triangle areas, used to pick triangles for light samples
+  std::vector<float> m_areaCDF;
+  std::shared_ptr<const void> m_owner;
+  //Either of the above, every lookup goes through it
+  MeshView m_view;
+  BVH m_bvh;
+  float m_invPDF;
+  bool m_valid;
+
+  void init();
+  void initView(const MeshView& view);
+  float intersectTriangle(const Ray& ray, unsigned int triangle) const;
+  void getBarycentrics(const Vector& point, unsigned int triangle, float& b1, float& b2) const;
+public:
+  TriangleMesh(MeshData data);
+  TriangleMesh(MeshData data, std::shared_ptr<BaseMaterial> mat);
+  TriangleMesh(const char* fileName);
+  TriangleMesh(const char* fileName, std::shared_ptr<BaseMaterial> mat);
+  //Uses the geometry and hierarchy of view without copying them, owner keeps them alive.
+  //The view has to be valid (see isValidView).
+  TriangleMesh(const MeshView& view, std::shared_ptr<const void> owner, std::shared_ptr<BaseMaterial> mat);
+  TriangleMesh(const TriangleMesh&) = delete;
+  TriangleMesh& operator=(const TriangleMesh&) = delete;
+
+  //Whether every index and node of view lies within its arrays
+  static bool isValidView(const MeshView& view);
+
+  bool isValid() const { return m_valid; }
+  size_t getTriangleCount() const { return m_view.triangleCount; }
+  size_t getVertexCount() const { return m_view.vertexCount; }
+  //Geometry in the layout the MeshView constructor takes, for storing it
+  const MeshView& getView() const { return m_view; }
+
+  float intersect(const Ray& ray) const override;
+  float intersectPrimitive(const Ray& ray, unsigned int& primitive) const override;
+  bool occludes(const Ray& ray, float maxT) const override;
+  Vector getNormalAt(const Vector& point, unsigned int primitive) const override;
+  void getUVAt(const Vector& point, unsigned int primitive, float& u, float& v) const override;
+  unsigned int getPrimitiveCount() const override { return m_view.triangleCount; }
+  AABB getBoundingBox() const override;
+  bool isFinite() const override { return true; }
+  SurfaceSample getSample(float u1, float u2) const override;
+  float getInversePDF() const override { return m_invPDF; }
+};
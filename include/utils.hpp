@@ -2,6 +2,7 @@
 
 class Vector;
 
+//Copies the pixels of an 8-bit binary PPM into a new[] array
 bool loadPPM(const char *fileName, int &width, int &height, char*& pixels);
 bool savePPM(const char *fileName, int width, int height, const char *pixels);
 
@@ -17,6 +17,7 @@ public:
   Vector& normalize();
   Vector& clamp(float min, float max);
   Vector clone() const { return Vector(x, y, z); }
+  float operator[](int axis) const { return axis == 0 ? x : (axis == 1 ? y : z); }
 
   Vector operator-() const { return Vector(-x, -y, -z); }
   Vector operator+(const Vector &other) const { return Vector(x + other.x, y + other.y, z + other.z); }
@@ -0,0 +1,60 @@
+#include "allocationCounter.hpp"
+
+#ifdef PATHTRACER_COUNT_ALLOCATIONS
+
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+  thread_local size_t allocationCount = 0;
+
+  void* allocate(size_t size)
+  {
+    ++allocationCount;
+    void* memory = std::malloc(size ? size : 1);
+    if(!memory) throw std::bad_alloc();
+    return memory;
+  }
+}
+
+void* operator new(size_t size) { return allocate(size); }
+void* operator new[](size_t size) { return allocate(size); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+  ++allocationCount;
+  return std::malloc(size ? size : 1);
+}
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+  ++allocationCount;
+  return std::malloc(size ? size : 1);
+}
+void operator delete(void* memory) noexcept { std::free(memory); }
+void operator delete[](void* memory) noexcept { std::free(memory); }
+void operator delete(void* memory, size_t) noexcept { std::free(memory); }
+void operator delete[](void* memory, size_t) noexcept { std::free(memory); }
+
+bool isAllocationCountingEnabled()
+{
+  return true;
+}
+
+size_t getThreadAllocationCount()
+{
+  return allocationCount;
+}
+
+#else
+
+bool isAllocationCountingEnabled()
+{
+  return false;
+}
+
+size_t getThreadAllocationCount()
+{
+  return 0;
+}
+
+#endif
@@ -0,0 +1,189 @@
+#include "bvh.hpp"
+
+#include <algorithm>
+
+namespace
+{
+  const int SAH_BINS = 16;
+  const float TRAVERSAL_COST = 1.0f;
+  const float INTERSECTION_COST = 1.0f;
+
+  //Levels of median splits below a node of count primitives until every leaf is small enough
+  unsigned int getMedianLevels(unsigned int count)
+  {
+    unsigned int levels = 0;
+    for(; count > BVH::MAX_LEAF_SIZE; count = (count + 1) / 2)
+      ++levels;
+    return levels;
+  }
+}
+
+void BVH::clear()
+{
+  m_nodes.clear();
+  m_indices.clear();
+  m_adopted = nullptr;
+  m_adoptedCount = 0;
+}
+
+bool BVH::adopt(const BVHNode* nodes, size_t nodeCount, size_t primitiveCount)
+{
+  clear();
+  if(nodeCount == 0) return primitiveCount == 0;
+
+  //Children always follow their parent, so depths are known before a node is reached.
+  //Traversal pushes at most one entry per level.
+  std::vector<unsigned char> depth(nodeCount, 0);
+  for(size_t i = 0; i < nodeCount; ++i)
+  {
+    const BVHNode& node = nodes[i];
+    if(node.count > 0)
+    {
+      if(node.offset > primitiveCount || node.count > primitiveCount - node.offset) return false;
+      continue;
+    }
+    if(node.axis > 2 || i + 1 >= nodeCount || node.offset <= i + 1 || node.offset >= nodeCount) return false;
+    if(depth[i] + 1u >= STACK_SIZE) return false;
+    depth[i + 1] = std::max<unsigned char>(depth[i + 1], depth[i] + 1);
+    depth[node.offset] = std::max<unsigned char>(depth[node.offset], depth[i] + 1);
+  }
+
+  m_adopted = nodes;
+  m_adoptedCount = nodeCount;
+  return true;
+}
+
+void BVH::build(const std::vector<AABB>& bounds)
+{
+  clear();
+  if(bounds.empty()) return;
+
+  std::vector<BuildEntry> entries(bounds.size());
+  for(size_t i = 0; i < bounds.size(); ++i)
+  {
+    entries[i].bounds = bounds[i];
+    entries[i].centroid = bounds[i].getCenter();
+    entries[i].index = i;
+  }
+
+  m_nodes.reserve(2 * bounds.size());
+  m_nodes.push_back(BVHNode());
+  buildRecursive(entries, 0, 0, entries.size(), 0);
+
+  m_indices.resize(entries.size());
+  for(size_t i = 0; i < entries.size(); ++i)
+    m_indices[i] = entries[i].index;
+}
+
+void BVH::buildRecursive(std::vector<BuildEntry>& entries, unsigned int nodeIndex, unsigned int begin, unsigned int end, unsigned int depth)
+{
+  AABB bounds, centroidBounds;
+  for(unsigned int i = begin; i < end; ++i)
+  {
+    bounds.extend(entries[i].bounds);
+    centroidBounds.extend(entries[i].centroid);
+  }
+  BVHNode& node = m_nodes[nodeIndex];
+  node.bounds = bounds;
+  node.axis = 0;
+
+  unsigned int count = end - begin;
+  if(count <= MAX_LEAF_SIZE)
+  {
+    node.offset = begin;
+    node.count = count;
+    return;
+  }
+
+  int axis = centroidBounds.getLongestAxis();
+  float axisMin = centroidBounds.min[axis];
+  float extent = centroidBounds.max[axis] - axisMin;
+  unsigned int mid = begin;
+
+  //SAH splits may be arbitrarily unbalanced. Once median splits are needed to finish the
+  //subtree within the traversal stack, nodes are split at the median: leaves stay within
+  //STACK_SIZE - 1 levels, as adopt() requires.
+  bool sah = depth + 1 + getMedianLevels(count) < STACK_SIZE;
+  if(sah && extent > 0.0f)
+  {
+    //Binned SAH along the longest centroid axis
+    AABB binBounds[SAH_BINS];
+    unsigned int binCount[SAH_BINS] = {0};
+    float scale = SAH_BINS / extent;
+    auto binOf = [&](const BuildEntry& e) { return std::min(SAH_BINS - 1, (int)((e.centroid[axis] - axisMin) * scale)); };
+    for(unsigned int i = begin; i < end; ++i)
+    {
+      int b = binOf(entries[i]);
+      binBounds[b].extend(entries[i].bounds);
+      ++binCount[b];
+    }
+
+    float rightArea[SAH_BINS];
+    unsigned int rightCount[SAH_BINS];
+    AABB accumulated;
+    unsigned int accumulatedCount = 0;
+    for(int b = SAH_BINS - 1; b > 0; --b)
+    {
+      accumulated.extend(binBounds[b]);
+      accumulatedCount += binCount[b];
+      rightArea[b] = accumulated.getSurfaceArea();
+      rightCount[b] = accumulatedCount;
+    }
+
+    float bestCost = std::numeric_limits<float>::max();
+    int bestBin = -1;
+    accumulated = AABB();
+    accumulatedCount = 0;
+    for(int b = 1; b < SAH_BINS; ++b)
+    {
+      accumulated.extend(binBounds[b - 1]);
+      accumulatedCount += binCount[b - 1];
+      if(accumulatedCount == 0 || rightCount[b] == 0) continue;
+      float cost = accumulated.getSurfaceArea() * accumulatedCount + rightArea[b] * rightCount[b];
+      if(cost < bestCost)
+      {
+        bestCost = cost;
+        bestBin = b;
+      }
+    }
+
+    if(bestBin > 0)
+    {
+      float area = bounds.getSurfaceArea();
+      float splitCost = TRAVERSAL_COST + (area > 0.0f ? INTERSECTION_COST * bestCost / area : 0.0f);
+      if(splitCost >= INTERSECTION_COST * count && count <= 4 * MAX_LEAF_SIZE)
+      {
+        node.offset = begin;
+        node.count = count;
+        return;
+      }
+
+      BuildEntry* first = entries.data() + begin;
+      BuildEntry* pivot = std::partition(first, first + count, [&](const BuildEntry& e) { return binOf(e) < bestBin; });
+      mid = begin + (pivot - first);
+    }
+  }
+
+  //Median split for coincident centroids and deep nodes
+  if(mid == begin || mid == end)
+  {
+    mid = begin + count / 2;
+    BuildEntry* first = entries.data() + begin;
+    std::nth_element(first, entries.data() + mid, first + count, [axis](const BuildEntry& a, const BuildEntry& b)
+    {
+      return a.centroid[axis] < b.centroid[axis];
+    });
+  }
+
+  node.count = 0;
+  node.axis = axis;
+
+  unsigned int left = m_nodes.size();
+  m_nodes.push_back(BVHNode());
+  buildRecursive(entries, left, begin, mid, depth + 1);
+
+  unsigned int right = m_nodes.size();
+  m_nodes.push_back(BVHNode());
+  m_nodes[nodeIndex].offset = right;
+  buildRecursive(entries, right, mid, end, depth + 1);
+}
@@ -0,0 +1,163 @@
+#include "compiledScene.hpp"
+
+#include <limits>
+#include <cmath>
+
+#include "object.hpp"
+#include "sphere.hpp"
+#include "rectangle.hpp"
+#include "ellipse.hpp"
+#include "core.hpp"
+
+namespace
+{
+  void pushPlanar(std::vector<float>& x, std::vector<float>& y, std::vector<float>& z, const Vector& v)
+  {
+    x.push_back(v.x);
+    y.push_back(v.y);
+    z.push_back(v.z);
+  }
+}
+
+CompiledScene::CompiledScene()
+{
+  updateBatches();
+}
+
+void CompiledScene::clear()
+{
+  m_spheres = SphereArrays();
+  m_rectangles = PlanarArrays();
+  m_ellipses = PlanarArrays();
+  m_sphereObjects.clear();
+  m_rectangleObjects.clear();
+  m_ellipseObjects.clear();
+  m_otherObjects.clear();
+  m_others.clear();
+  updateBatches();
+}
+
+void CompiledScene::build(const std::vector<std::shared_ptr<Object>>& objects)
+{
+  clear();
+
+  for(size_t i = 0; i < objects.size(); ++i)
+  {
+    const Object* object = objects[i].get();
+    if(const Sphere* sphere = dynamic_cast<const Sphere*>(object))
+    {
+      pushPlanar(m_spheres.centerX, m_spheres.centerY, m_spheres.centerZ, sphere->center);
+      m_spheres.radius.push_back(sphere->getRadius());
+      m_sphereObjects.push_back(i);
+    }
+    else if(const Rectangle* rectangle = dynamic_cast<const Rectangle*>(object))
+    {
+      PlanarArrays& a = m_rectangles;
+      pushPlanar(a.pointX, a.pointY, a.pointZ, rectangle->point);
+      pushPlanar(a.normalX, a.normalY, a.normalZ, rectangle->getNormal());
+      pushPlanar(a.tangentX, a.tangentY, a.tangentZ, rectangle->getTangent());
+      pushPlanar(a.bitangentX, a.bitangentY, a.bitangentZ, rectangle->getBitangent());
+      a.sizeTangent.push_back(rectangle->getSizeTangent());
+      a.sizeBitangent.push_back(rectangle->getSizeBitangent());
+      m_rectangleObjects.push_back(i);
+    }
+    else if(const Ellipse* ellipse = dynamic_cast<const Ellipse*>(object))
+    {
+      //Center, axes and semi-axes take the slots of the rectangle's corner, edges and sizes
+      PlanarArrays& a = m_ellipses;
+      pushPlanar(a.pointX, a.pointY, a.pointZ, ellipse->center);
+      pushPlanar(a.normalX, a.normalY, a.normalZ, ellipse->getNormal());
+      pushPlanar(a.tangentX, a.tangentY, a.tangentZ, ellipse->getAxisTangent());
+      pushPlanar(a.bitangentX, a.bitangentY, a.bitangentZ, ellipse->getAxisBitangent());
+      a.sizeTangent.push_back(ellipse->getSemiTangent());
+      a.sizeBitangent.push_back(ellipse->getSemiBitangent());
+      m_ellipseObjects.push_back(i);
+    }
+    else
+    {
+      m_others.push_back(object);
+      m_otherObjects.push_back(i);
+    }
+  }
+
+  updateBatches();
+}
+
+void CompiledScene::updateBatches()
+{
+  m_sphereBatch = {m_spheres.centerX.data(), m_spheres.centerY.data(), m_spheres.centerZ.data(),
+                   m_spheres.radius.data(), m_spheres.radius.size()};
+
+  const PlanarArrays& r = m_rectangles;
+  m_rectangleBatch = {r.pointX.data(), r.pointY.data(), r.pointZ.data(),
+                      r.normalX.data(), r.normalY.data(), r.normalZ.data(),
+                      r.tangentX.data(), r.tangentY.data(), r.tangentZ.data(),
+                      r.bitangentX.data(), r.bitangentY.data(), r.bitangentZ.data(),
+                      r.sizeTangent.data(), r.sizeBitangent.data(), r.sizeTangent.size()};
+
+  const PlanarArrays& e = m_ellipses;
+  m_ellipseBatch = {e.pointX.data(), e.pointY.data(), e.pointZ.data(),
+                    e.normalX.data(), e.normalY.data(), e.normalZ.data(),
+                    e.tangentX.data(), e.tangentY.data(), e.tangentZ.data(),
+                    e.bitangentX.data(), e.bitangentY.data(), e.bitangentZ.data(),
+                    e.sizeTangent.data(), e.sizeBitangent.data(), e.sizeTangent.size()};
+}
+
+int CompiledScene::intersect(const Ray& ray, float& closestT, unsigned int& primitive) const
+{
+  int object = -1;
+  primitive = 0;
+
+  //Kernels also report hits at exactly closestT, those go to the object added first
+  //as in a linear scan
+  auto consider = [&](int hit, float t, const std::vector<unsigned int>& objects)
+  {
+    if(hit < 0) return;
+    int index = objects[hit];
+    if(object < 0 || t < closestT || index < object)
+    {
+      closestT = t;
+      object = index;
+      primitive = 0;
+    }
+  };
+
+  const float inf = std::numeric_limits<float>::infinity();
+  float t = std::nextafter(closestT, inf);
+  int hit = intersectSpheres(ray, m_sphereBatch, t);
+  consider(hit, t, m_sphereObjects);
+  t = std::nextafter(closestT, inf);
+  hit = intersectRectangles(ray, m_rectangleBatch, t);
+  consider(hit, t, m_rectangleObjects);
+  t = std::nextafter(closestT, inf);
+  hit = intersectEllipses(ray, m_ellipseBatch, t);
+  consider(hit, t, m_ellipseObjects);
+
+  unsigned int prim;
+  for(size_t i = 0; i < m_others.size(); ++i)
+  {
+    t = m_others[i]->intersectPrimitive(ray, prim);
+    if(t > 0.0f && (t < closestT || (t == closestT && (int)m_otherObjects[i] < object)))
+    {
+      closestT = t;
+      object = m_otherObjects[i];
+      primitive = prim;
+    }
+  }
+
+  return object;
+}
+
+bool CompiledScene::occlusionTest(const Ray& ray, float maxT) const
+{
+  if(occludedSpheres(ray, m_sphereBatch, maxT)) return true;
+  if(occludedRectangles(ray, m_rectangleBatch, maxT)) return true;
+  if(occludedEllipses(ray, m_ellipseBatch, maxT)) return true;
+
+  for(size_t i = 0; i < m_others.size(); ++i)
+  {
+    if(m_others[i]->occludes(ray, maxT))
+      return true;
+  }
+  return false;
+}
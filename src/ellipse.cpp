@@ -1,5 +1,6 @@
 #include "ellipse.hpp"
 #include "core.hpp"
+#include "aabb.hpp"
 
 void Ellipse::setSemiTangent(float semiTangent)
 {
@@ -31,12 +32,21 @@ float Ellipse::intersect(const Ray& ray) const
   return t;
 }
 
-Vector Ellipse::getNormalAt(const Vector&) const
+AABB Ellipse::getBoundingBox() const
+{
+  Vector t = m_axisT * m_semiTangent;
+  Vector b = m_axisB * m_semiBitangent;
+  //Extent of the ellipse along each world axis
+  Vector extent(sqrtf(t.x*t.x + b.x*b.x), sqrtf(t.y*t.y + b.y*b.y), sqrtf(t.z*t.z + b.z*b.z));
+  return AABB(center - extent, center + extent);
+}
+
+Vector Ellipse::getNormalAt(const Vector&, unsigned int) const
 {
   return m_normal;
 }
 
-void Ellipse::getUVAt(const Vector& point, float& u, float& v) const
+void Ellipse::getUVAt(const Vector& point, unsigned int, float& u, float& v) const
 {
   Vector relPoint = point - center;
   float distT = relPoint.dot(m_axisT);
@@ -45,32 +55,11 @@ void Ellipse::getUVAt(const Vector& point, float& u, float& v) const
   v = (distB / 2*m_semiBitangent) + 0.5;
 }
 
-Vector Ellipse::getSample(RNG& rng) const
+SurfaceSample Ellipse::getSample(float u1, float u2) const
 {
-  float r = sqrtf(rng.get());
-  float theta = 2.0f*M_PI*rng.get();
+  float r = sqrtf(u1);
+  float theta = 2.0f*M_PI*u2;
   float x = r*cosf(theta)*m_semiTangent;
   float y = r*sinf(theta)*m_semiBitangent;
-  return x*m_axisT + y*m_axisB + center;
+  return {x*m_axisT + y*m_axisB + center, 0};
 }
-
-void Ellipse::getSamples(RNG& rng, int s1, int s2, Vector* samples) const
-{
-  float invS1 = 1.0f/s1;
-  float invS2 = 1.0f/s2;
-  float r1, r2, r, theta, x, y;
-  int i = 0;
-  for(int ny = 0; ny < s2; ++ny)
-  {
-    for(int nx = 0; nx < s1; ++nx)
-    {
-      r1 = (nx + rng.get())*invS1;
-      r2 = (ny + rng.get())*invS2;
-      r = sqrt(r1);
-      theta = 2.0f*M_PI*r2;
-      x = r*cosf(theta)*m_semiTangent;
-      y = r*sinf(theta)*m_semiBitangent;
-      samples[i++] = x*m_axisT + y*m_axisB + center;
-    }
-  }
-}
\ No newline at end of file
@@ -1,8 +1,96 @@
 #include "environmentMap.hpp"
 
+#include <algorithm>
+#include <cmath>
+
 #include "vector.hpp"
 
-EnvironmentMap::EnvironmentMap(): m_texture(Vector(0, 0, 0)) {}
+namespace
+{
+  //The distribution has at least this many rows and columns, so even a constant
+  //environment is sampled in proportion to the solid angle of its cells
+  const unsigned int MIN_RESOLUTION = 64;
+  const float ONE_MINUS_EPSILON = 0.99999994f;
+
+  //Turns count weights into a cumulative distribution of count + 1 entries, returns their sum
+  float buildCDF(const float* weights, unsigned int count, float* cdf)
+  {
+    cdf[0] = 0.0f;
+    for(unsigned int i = 0; i < count; ++i)
+      cdf[i + 1] = cdf[i] + weights[i];
+    float total = cdf[count];
+    for(unsigned int i = 1; i <= count; ++i)
+      cdf[i] = total > 0.0f ? cdf[i] / total : (float)i / count;
+    cdf[count] = 1.0f;
+    return total;
+  }
+
+  //Interval of the cdf containing u, u is set to its position within the interval
+  unsigned int sampleCDF(const float* cdf, unsigned int count, float& u)
+  {
+    unsigned int i = std::upper_bound(cdf, cdf + count + 1, u) - cdf;
+    i = std::min(std::max(i, 1u), count) - 1;
+    float width = cdf[i + 1] - cdf[i];
+    u = width > 0.0f ? std::min((u - cdf[i]) / width, ONE_MINUS_EPSILON) : 0.5f;
+    return i;
+  }
+}
+
+EnvironmentMap::EnvironmentMap(): m_texture(Vector(0, 0, 0))
+{
+  buildDistribution();
+}
+
+EnvironmentMap::EnvironmentMap(const Texture& texture): m_texture(texture)
+{
+  buildDistribution();
+}
+
+EnvironmentMap::EnvironmentMap(const Vector& color): m_texture(color)
+{
+  buildDistribution();
+}
+
+EnvironmentMap::EnvironmentMap(const char* fileName): m_texture(fileName)
+{
+  buildDistribution();
+}
+
+void EnvironmentMap::buildDistribution()
+{
+  m_width = m_height = 0;
+  m_totalWeight = 0.0f;
+  m_weights.clear();
+  m_marginalCDF.clear();
+  m_conditionalCDF.clear();
+  if(!m_texture.isValid()) return;
+
+  //Textures are sampled at the nearest texel, so cells which evenly split the texels
+  //have a constant radiance
+  unsigned int texWidth = m_texture.getWidth(), texHeight = m_texture.getHeight();
+  m_width = texWidth * ((MIN_RESOLUTION + texWidth - 1) / texWidth);
+  m_height = texHeight * ((MIN_RESOLUTION + texHeight - 1) / texHeight);
+
+  m_weights.resize(m_width * m_height);
+  for(unsigned int y = 0; y < m_height; ++y)
+  {
+    float v = (y + 0.5f) / m_height;
+    float sinTheta = std::sin(M_PI * v);
+    for(unsigned int x = 0; x < m_width; ++x)
+    {
+      Vector c = m_texture.sample((x + 0.5f) / m_width, v);
+      float luminance = 0.2126f * c.x + 0.7152f * c.y + 0.0722f * c.z;
+      m_weights[y * m_width + x] = std::max(luminance, 0.0f) * sinTheta;
+    }
+  }
+
+  std::vector<float> rowWeights(m_height);
+  m_conditionalCDF.resize(m_height * (m_width + 1));
+  for(unsigned int y = 0; y < m_height; ++y)
+    rowWeights[y] = buildCDF(&m_weights[y * m_width], m_width, &m_conditionalCDF[y * (m_width + 1)]);
+  m_marginalCDF.resize(m_height + 1);
+  m_totalWeight = buildCDF(rowWeights.data(), m_height, m_marginalCDF.data());
+}
 
 Vector EnvironmentMap::sample(const Vector& vec) const
 {
@@ -13,3 +101,34 @@ Vector EnvironmentMap::sample(const Vector& vec) const
 
   return m_texture.sample(u, v);
 }
+
+Vector EnvironmentMap::sampleDirection(float u1, float u2, float& pdf) const
+{
+  pdf = 0.0f;
+  if(!isSamplable()) return Vector(0, 1, 0);
+
+  unsigned int y = sampleCDF(m_marginalCDF.data(), m_height, u2);
+  unsigned int x = sampleCDF(&m_conditionalCDF[y * (m_width + 1)], m_width, u1);
+
+  float theta = (y + u2) / m_height * M_PI;
+  float phi = ((x + u1) / m_width - 0.5f) * 2.0f * M_PI;
+  float sinTheta = std::sin(theta);
+  if(sinTheta <= 0.0f) return Vector(0, 1, 0);
+
+  //The density over the texture is converted to solid angle, dw = 2 pi^2 sin(theta) du dv
+  pdf = m_weights[y * m_width + x] * m_width * m_height / (m_totalWeight * 2.0f * M_PI * M_PI * sinTheta);
+  return Vector(sinTheta * std::sin(phi), std::cos(theta), sinTheta * std::cos(phi));
+}
+
+float EnvironmentMap::getPDF(const Vector& vec) const
+{
+  if(!isSamplable()) return 0.0f;
+
+  float theta = acos(std::min(1.0f, std::max(-1.0f, vec.y)));
+  float sinTheta = std::sin(theta);
+  if(sinTheta <= 0.0f) return 0.0f;
+  float phi = atan2(vec.x, vec.z);
+  unsigned int x = std::min((unsigned int)((phi * 0.5f * M_1_PI + 0.5f) * m_width), m_width - 1);
+  unsigned int y = std::min((unsigned int)(theta * M_1_PI * m_height), m_height - 1);
+  return m_weights[y * m_width + x] * m_width * m_height / (m_totalWeight * 2.0f * M_PI * M_PI * sinTheta);
+}
@@ -0,0 +1,190 @@
+#include "film.hpp"
+#include "imageFile.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <numeric>
+#include <string>
+
+namespace
+{
+  const char FILM_MAGIC[4] = {'P', 'T', 'F', 'M'};
+  const unsigned int FILM_VERSION = 3;
+
+  struct FilmHeader
+  {
+    char magic[4];
+    unsigned int version;
+    unsigned int width, height;
+    unsigned int left, top;
+    unsigned int imageWidth, imageHeight;
+    unsigned int firstSample;
+    unsigned int seed, passes;
+  };
+}
+
+Film::Film(unsigned int width, unsigned int height, unsigned int seed)
+{
+  reset(width, height, seed);
+}
+
+void Film::reset(unsigned int width, unsigned int height, unsigned int seed)
+{
+  m_width = width;
+  m_height = height;
+  m_left = m_top = 0;
+  m_imageWidth = width;
+  m_imageHeight = height;
+  m_firstSample = 0;
+  m_seed = seed;
+  m_passes = 0;
+  m_sum.assign(width * height, Vector(0, 0, 0));
+  m_halfSum.assign(width * height, Vector(0, 0, 0));
+  m_samples.assign(width * height, 0);
+}
+
+bool Film::setRegion(unsigned int left, unsigned int top, unsigned int imageWidth, unsigned int imageHeight)
+{
+  if(m_width > imageWidth || left > imageWidth - m_width) return false;
+  if(m_height > imageHeight || top > imageHeight - m_height) return false;
+  m_left = left;
+  m_top = top;
+  m_imageWidth = imageWidth;
+  m_imageHeight = imageHeight;
+  return true;
+}
+
+bool Film::merge(const Film& part)
+{
+  if(m_left != 0 || m_top != 0 || m_width != m_imageWidth || m_height != m_imageHeight) return false;
+  if(part.m_imageWidth != m_width || part.m_imageHeight != m_height || part.m_seed != m_seed) return false;
+
+  for(unsigned int y = 0; y < part.m_height; ++y)
+  {
+    for(unsigned int x = 0; x < part.m_width; ++x)
+    {
+      unsigned int i = y * part.m_width + x;
+      addSamples(part.m_left + x, part.m_top + y, part.m_sum[i], part.m_halfSum[i], part.m_samples[i]);
+    }
+  }
+  m_passes = std::max(m_passes, part.m_passes);
+  return true;
+}
+
+Vector Film::getColor(unsigned int x, unsigned int y) const
+{
+  unsigned int i = y * m_width + x;
+  if(m_samples[i] == 0) return Vector(0, 0, 0);
+  return m_sum[i] / (float)m_samples[i];
+}
+
+unsigned int Film::getMinSampleCount() const
+{
+  if(m_samples.empty()) return 0;
+  return *std::min_element(m_samples.begin(), m_samples.end());
+}
+
+unsigned long long Film::getTotalSampleCount() const
+{
+  return std::accumulate(m_samples.begin(), m_samples.end(), 0ull);
+}
+
+float Film::getError(unsigned int x, unsigned int y) const
+{
+  unsigned int i = y * m_width + x;
+  if(m_samples[i] < 2) return std::numeric_limits<float>::infinity();
+
+  Vector all = m_sum[i] / (float)m_samples[i];
+  Vector half = m_halfSum[i] / (float)(m_samples[i] / 2);
+  float difference = std::fabs(all.x - half.x) + std::fabs(all.y - half.y) + std::fabs(all.z - half.z);
+  return difference / (0.0001f + std::sqrt(all.x + all.y + all.z));
+}
+
+bool Film::save(const char* fileName) const
+{
+  std::string tempName = std::string(fileName) + ".tmp";
+  std::ofstream file(tempName, std::ios::binary);
+  if(!file.is_open()) return false;
+
+  FilmHeader header;
+  std::memcpy(header.magic, FILM_MAGIC, 4);
+  header.version = FILM_VERSION;
+  header.width = m_width;
+  header.height = m_height;
+  header.left = m_left;
+  header.top = m_top;
+  header.imageWidth = m_imageWidth;
+  header.imageHeight = m_imageHeight;
+  header.firstSample = m_firstSample;
+  header.seed = m_seed;
+  header.passes = m_passes;
+  file.write((const char*)&header, sizeof(header));
+
+  for(size_t i = 0; i < m_sum.size(); ++i)
+  {
+    float sum[6] = {m_sum[i].x, m_sum[i].y, m_sum[i].z, m_halfSum[i].x, m_halfSum[i].y, m_halfSum[i].z};
+    file.write((const char*)sum, sizeof(sum));
+  }
+  file.write((const char*)m_samples.data(), m_samples.size() * sizeof(unsigned int));
+
+  file.close();
+  if(!file) return false;
+  return std::rename(tempName.c_str(), fileName) == 0;
+}
+
+bool Film::load(const char* fileName)
+{
+  std::ifstream file(fileName, std::ios::binary);
+  if(!file.is_open()) return false;
+
+  FilmHeader header;
+  if(!file.read((char*)&header, sizeof(header))) return false;
+  if(std::memcmp(header.magic, FILM_MAGIC, 4) != 0 || header.version != FILM_VERSION) return false;
+  if(header.width > header.imageWidth || header.left > header.imageWidth - header.width) return false;
+  if(header.height > header.imageHeight || header.top > header.imageHeight - header.height) return false;
+
+  std::vector<Vector> sum(header.width * header.height);
+  std::vector<Vector> halfSum(header.width * header.height);
+  std::vector<unsigned int> samples(header.width * header.height);
+  for(size_t i = 0; i < sum.size(); ++i)
+  {
+    float s[6];
+    if(!file.read((char*)s, sizeof(s))) return false;
+    sum[i] = Vector(s[0], s[1], s[2]);
+    halfSum[i] = Vector(s[3], s[4], s[5]);
+  }
+  if(!file.read((char*)samples.data(), samples.size() * sizeof(unsigned int))) return false;
+
+  m_width = header.width;
+  m_height = header.height;
+  m_left = header.left;
+  m_top = header.top;
+  m_imageWidth = header.imageWidth;
+  m_imageHeight = header.imageHeight;
+  m_firstSample = header.firstSample;
+  m_seed = header.seed;
+  m_passes = header.passes;
+  m_sum.swap(sum);
+  m_halfSum.swap(halfSum);
+  m_samples.swap(samples);
+  return true;
+}
+
+bool Film::savePFM(const char* fileName) const
+{
+  PFMWriter writer;
+  if(!writer.open(fileName, m_width, m_height)) return false;
+
+  std::vector<Vector> row(m_width);
+  for(unsigned int y = 0; y < m_height; ++y)
+  {
+    for(unsigned int x = 0; x < m_width; ++x)
+      row[x] = getColor(x, y);
+    if(!writer.writeRow(y, row.data())) return false;
+  }
+  return writer.close();
+}
@@ -0,0 +1,106 @@
+#include "group.hpp"
+#include "core.hpp"
+
+#include <algorithm>
+#include <limits>
+
+Group::Group(const std::vector<std::shared_ptr<Object>>& objects): Object(nullptr), m_primitiveCount(0)
+{
+  std::vector<std::shared_ptr<Object>> finite;
+  std::vector<AABB> bounds;
+  for(size_t i = 0; i < objects.size(); ++i)
+  {
+    if(!objects[i]->isFinite()) continue;
+    AABB box = objects[i]->getBoundingBox();
+    //Flat shapes would get zero-thickness boxes
+    box.pad(0.0001f);
+    finite.push_back(objects[i]);
+    bounds.push_back(box);
+    m_bounds.extend(box);
+  }
+
+  m_bvh.build(bounds);
+  const std::vector<unsigned int>& indices = m_bvh.getIndices();
+  float area = 0.0f;
+  for(size_t i = 0; i < indices.size(); ++i)
+  {
+    const std::shared_ptr<Object>& object = finite[indices[i]];
+    m_objects.push_back(object);
+    m_firstPrimitives.push_back(m_primitiveCount);
+    m_primitiveCount += object->getPrimitiveCount();
+    area += object->getInversePDF();
+    m_areaCDF.push_back(area);
+  }
+}
+
+size_t Group::findPart(unsigned int primitive) const
+{
+  return std::upper_bound(m_firstPrimitives.begin(), m_firstPrimitives.end(), primitive) - m_firstPrimitives.begin() - 1;
+}
+
+float Group::intersect(const Ray& ray) const
+{
+  unsigned int primitive;
+  return intersectPrimitive(ray, primitive);
+}
+
+float Group::intersectPrimitive(const Ray& ray, unsigned int& primitive) const
+{
+  float closestT = std::numeric_limits<float>::max();
+  bool hit = m_bvh.intersect(ray, closestT, [&](unsigned int i, float& tMax)
+  {
+    unsigned int prim;
+    float t = m_objects[i]->intersectPrimitive(ray, prim);
+    if(t > 0.0f && t < tMax)
+    {
+      tMax = t;
+      primitive = m_firstPrimitives[i] + prim;
+      return true;
+    }
+    return false;
+  });
+  return hit ? closestT : -1.0f;
+}
+
+bool Group::occludes(const Ray& ray, float maxT) const
+{
+  return m_bvh.occluded(ray, maxT, [&](unsigned int i)
+  {
+    return m_objects[i]->occludes(ray, maxT);
+  });
+}
+
+Vector Group::getNormalAt(const Vector& point, unsigned int primitive) const
+{
+  size_t part = findPart(primitive);
+  return m_objects[part]->getNormalAt(point, primitive - m_firstPrimitives[part]);
+}
+
+void Group::getUVAt(const Vector& point, unsigned int primitive, float& u, float& v) const
+{
+  size_t part = findPart(primitive);
+  m_objects[part]->getUVAt(point, primitive - m_firstPrimitives[part], u, v);
+}
+
+const BaseMaterial* Group::getMaterial(unsigned int primitive) const
+{
+  size_t part = findPart(primitive);
+  return m_objects[part]->getMaterial(primitive - m_firstPrimitives[part]);
+}
+
+SurfaceSample Group::getSample(float u1, float u2) const
+{
+  if(m_objects.empty()) return {Vector(0, 0, 0), 0};
+
+  //u1 picks a part proportionally to its area and is then reused inside it
+  float target = u1 * m_areaCDF.back();
+  size_t part = std::upper_bound(m_areaCDF.begin(), m_areaCDF.end(), target) - m_areaCDF.begin();
+  part = std::min(part, m_objects.size() - 1);
+  float start = part > 0 ? m_areaCDF[part - 1] : 0.0f;
+  float area = m_areaCDF[part] - start;
+  u1 = area > 0.0f ? std::min((target - start) / area, 1.0f) : 0.0f;
+
+  SurfaceSample sample = m_objects[part]->getSample(u1, u2);
+  sample.primitive += m_firstPrimitives[part];
+  return sample;
+}
@@ -0,0 +1,245 @@
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+#include "imageFile.hpp"
+#include "utils.hpp"
+#include "vector.hpp"
+
+namespace
+{
+  //Skips whitespace and comments up to the next token of a header
+  void skipSpace(const uint8_t*& p, const uint8_t* end)
+  {
+    while(p < end)
+    {
+      if(*p == '#')
+      {
+        while(p < end && *p != '\n') ++p;
+      }
+      else if(std::isspace(*p)) ++p;
+      else break;
+    }
+  }
+
+  bool readInt(const uint8_t*& p, const uint8_t* end, int& value)
+  {
+    skipSpace(p, end);
+    if(p == end || !std::isdigit(*p)) return false;
+    long long result = 0;
+    while(p < end && std::isdigit(*p))
+    {
+      result = 10 * result + (*p++ - '0');
+      if(result > (1 << 30)) return false;
+    }
+    value = result;
+    return true;
+  }
+
+  bool readFloat(const uint8_t*& p, const uint8_t* end, float& value)
+  {
+    skipSpace(p, end);
+    char token[64];
+    size_t length = 0;
+    while(p < end && !std::isspace(*p) && length < sizeof(token) - 1) token[length++] = *p++;
+    token[length] = '\0';
+    char* tokenEnd = nullptr;
+    value = std::strtof(token, &tokenEnd);
+    return length > 0 && *tokenEnd == '\0';
+  }
+
+  bool isHostBigEndian()
+  {
+    uint16_t one = 1;
+    uint8_t first;
+    std::memcpy(&first, &one, 1);
+    return first == 0;
+  }
+}
+
+ImageFile::ImageFile(const char* fileName): m_file(fileName), m_format(Format::Invalid), m_width(0), m_height(0),
+  m_channels(0), m_scale(1.0f), m_bigEndian(false), m_pixels(nullptr)
+{
+  if(m_file.isOpen() && !parse())
+  {
+    m_format = Format::Invalid;
+    m_width = m_height = 0;
+    m_pixels = nullptr;
+  }
+}
+
+bool ImageFile::parse()
+{
+  const uint8_t* p = m_file.getData();
+  const uint8_t* end = p + m_file.getSize();
+  if(end - p < 3 || p[0] != 'P') return false;
+
+  size_t bytesPerPixel;
+  if(p[1] == '6')
+  {
+    int maxValue;
+    p += 2;
+    if(!readInt(p, end, m_width) || !readInt(p, end, m_height) || !readInt(p, end, maxValue)) return false;
+    if(maxValue <= 0 || maxValue > 65535) return false;
+    m_format = Format::PPM;
+    m_channels = 3;
+    m_scale = maxValue;
+    bytesPerPixel = maxValue < 256 ? 3 : 6;
+  }
+  else if(p[1] == 'F' || p[1] == 'f')
+  {
+    m_channels = p[1] == 'F' ? 3 : 1;
+    p += 2;
+    float scale;
+    if(!readInt(p, end, m_width) || !readInt(p, end, m_height) || !readFloat(p, end, scale) || scale == 0.0f) return false;
+    m_format = Format::PFM;
+    m_bigEndian = scale > 0.0f;
+    m_scale = std::abs(scale);
+    bytesPerPixel = 4 * m_channels;
+  }
+  else return false;
+
+  //A single whitespace character separates the header from the pixels
+  if(p == end || !std::isspace(*p)) return false;
+  ++p;
+
+  if(m_width <= 0 || m_height <= 0) return false;
+  if((size_t)(end - p) / bytesPerPixel / m_width < (size_t)m_height) return false;
+  m_pixels = p;
+  return true;
+}
+
+const uint8_t* ImageFile::getSRGB() const
+{
+  return m_format == Format::PPM && m_scale == 255.0f ? m_pixels : nullptr;
+}
+
+std::vector<float> ImageFile::getLinear() const
+{
+  std::vector<float> data;
+  if(!isValid()) return data;
+  size_t count = (size_t)m_width * m_height;
+  data.resize(3 * count);
+
+  if(m_format == Format::PPM)
+  {
+    //Every value of the file decoded once
+    int maxValue = m_scale;
+    std::vector<float> decoded(maxValue + 1);
+    for(int i = 0; i <= maxValue; ++i)
+    {
+      decoded[i] = (float)i / maxValue;
+      sRGBDecode(decoded[i]);
+    }
+
+    for(size_t i = 0; i < 3 * count; ++i)
+    {
+      int value = maxValue < 256 ? m_pixels[i] : (m_pixels[2 * i] << 8 | m_pixels[2 * i + 1]);
+      data[i] = decoded[std::min(value, maxValue)];
+    }
+    return data;
+  }
+
+  //PFM rows are stored bottom to top
+  bool swap = m_bigEndian != isHostBigEndian();
+  for(int y = 0; y < m_height; ++y)
+  {
+    const uint8_t* row = m_pixels + (size_t)(m_height - 1 - y) * m_width * m_channels * 4;
+    float* out = &data[3 * (size_t)y * m_width];
+    for(int x = 0; x < m_width; ++x)
+    {
+      for(int c = 0; c < 3; ++c)
+      {
+        const uint8_t* bytes = row + 4 * (x * m_channels + (m_channels == 3 ? c : 0));
+        uint8_t value[4] = {bytes[0], bytes[1], bytes[2], bytes[3]};
+        if(swap)
+        {
+          std::swap(value[0], value[3]);
+          std::swap(value[1], value[2]);
+        }
+        float f;
+        std::memcpy(&f, value, sizeof(f));
+        out[3 * x + c] = f * m_scale;
+      }
+    }
+  }
+  return data;
+}
+
+bool PFMWriter::open(const char* fileName, int width, int height)
+{
+  m_file.open(fileName, std::ios::binary | std::ios::trunc);
+  if(!m_file.is_open()) return false;
+
+  m_width = width;
+  m_height = height;
+  m_file << "PF\n" << width << " " << height << "\n-1.0\n";
+  m_pixelsStart = m_file.tellp();
+  m_row.resize(3 * width);
+  return (bool)m_file;
+}
+
+bool PFMWriter::writeRow(int y, const Vector* pixels)
+{
+  if(!m_file.is_open() || y < 0 || y >= m_height) return false;
+
+  bool swap = isHostBigEndian();
+  for(int x = 0; x < m_width; ++x)
+  {
+    float rgb[3] = {pixels[x].x, pixels[x].y, pixels[x].z};
+    for(int c = 0; c < 3; ++c)
+    {
+      uint8_t* bytes = (uint8_t*)&m_row[3 * x + c];
+      std::memcpy(bytes, &rgb[c], sizeof(float));
+      if(swap)
+      {
+        std::swap(bytes[0], bytes[3]);
+        std::swap(bytes[1], bytes[2]);
+      }
+    }
+  }
+
+  //PFM rows are stored bottom to top
+  std::streamoff rowBytes = 3 * sizeof(float) * (std::streamoff)m_width;
+  m_file.seekp(m_pixelsStart + (m_height - 1 - y) * rowBytes);
+  m_file.write((const char*)m_row.data(), rowBytes);
+  return (bool)m_file;
+}
+
+bool PFMWriter::close()
+{
+  if(!m_file.is_open()) return false;
+  m_file.close();
+  return (bool)m_file;
+}
+
+bool PPMWriter::open(const char* fileName, int width, int height)
+{
+  m_file.open(fileName, std::ios::binary | std::ios::trunc);
+  if(!m_file.is_open()) return false;
+
+  m_width = width;
+  m_height = height;
+  m_file << "P6\n" << width << "\n" << height << "\n255\n";
+  m_pixelsStart = m_file.tellp();
+  return (bool)m_file;
+}
+
+bool PPMWriter::writeRows(int y, int count, const char* pixels)
+{
+  if(!m_file.is_open() || y < 0 || count < 0 || y + count > m_height) return false;
+
+  std::streamoff rowBytes = 3 * (std::streamoff)m_width;
+  m_file.seekp(m_pixelsStart + y * rowBytes);
+  m_file.write(pixels, count * rowBytes);
+  return (bool)m_file;
+}
+
+bool PPMWriter::close()
+{
+  if(!m_file.is_open()) return false;
+  m_file.close();
+  return (bool)m_file;
+}
@@ -0,0 +1,57 @@
+#include "instance.hpp"
+#include "core.hpp"
+
+#include <cmath>
+
+Instance::Instance(std::shared_ptr<const Object> object, const Transform& toWorld): Object(nullptr), m_object(object), m_toWorld(toWorld)
+{
+  m_toObject = toWorld.inverse();
+  m_bounds = toWorld.applyToBox(object->getBoundingBox());
+  m_areaScale = std::pow(std::fabs(toWorld.getDeterminant()), 2.0f / 3.0f);
+}
+
+Ray Instance::toObject(const Ray& ray, float& scale) const
+{
+  Vector direction = m_toObject.applyToVector(ray.direction);
+  scale = direction.length();
+  return Ray(m_toObject.applyToPoint(ray.origin), direction / scale);
+}
+
+float Instance::intersect(const Ray& ray) const
+{
+  float scale;
+  float t = m_object->intersect(toObject(ray, scale));
+  return t > 0.0f ? t / scale : -1.0f;
+}
+
+float Instance::intersectPrimitive(const Ray& ray, unsigned int& primitive) const
+{
+  float scale;
+  float t = m_object->intersectPrimitive(toObject(ray, scale), primitive);
+  return t > 0.0f ? t / scale : -1.0f;
+}
+
+bool Instance::occludes(const Ray& ray, float maxT) const
+{
+  float scale;
+  Ray objectRay = toObject(ray, scale);
+  return m_object->occludes(objectRay, maxT < 0.0f ? maxT : maxT * scale);
+}
+
+Vector Instance::getNormalAt(const Vector& point, unsigned int primitive) const
+{
+  Vector normal = m_object->getNormalAt(m_toObject.applyToPoint(point), primitive);
+  return m_toObject.applyToNormal(normal).normalize();
+}
+
+void Instance::getUVAt(const Vector& point, unsigned int primitive, float& u, float& v) const
+{
+  m_object->getUVAt(m_toObject.applyToPoint(point), primitive, u, v);
+}
+
+SurfaceSample Instance::getSample(float u1, float u2) const
+{
+  SurfaceSample sample = m_object->getSample(u1, u2);
+  sample.point = m_toWorld.applyToPoint(sample.point);
+  return sample;
+}
@@ -2,19 +2,23 @@
 
 #include <cmath>
 #include "vector.hpp"
-#include "core.hpp"
 
 float LambertBRDF::f(const Vector&, const Vector&) const
 {
   return diffuseFactor*M_1_PI;
 }
 
-float LambertBRDF::sample_f(const Vector&, Vector& wi, RNG& rng, float& pdf) const
+float LambertBRDF::sample_f(const Vector&, Vector& wi, float u1, float u2, float& pdf) const
 {
-  float sinT = sqrtf(rng.get());
+  float sinT = sqrtf(u1);
   float cosT = sqrtf(1 - sinT * sinT);
-  float phi = 2*M_PI*rng.get();
+  float phi = 2*M_PI*u2;
   wi = Vector(sinT * cosf(phi), cosT, sinT * sinf(phi));
   pdf = cosT*M_1_PI;
   return diffuseFactor*M_1_PI;
+}
+
+float LambertBRDF::pdf(const Vector&, const Vector& wi) const
+{
+  return wi.y > 0.0f ? wi.y*M_1_PI : 0.0f;
 }
\ No newline at end of file
@@ -0,0 +1,350 @@
+#include "lightTree.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "object.hpp"
+#include "baseMaterial.hpp"
+
+namespace
+{
+  const float PI = 3.14159265358979f;
+  const int SAOH_BUCKETS = 12;
+  //Beyond this depth nodes are split at the median, which keeps the trails within 64 bits
+  const unsigned int MAX_SAOH_DEPTH = 30;
+  //Grid of points used to average the emittance of a light
+  const int POWER_SAMPLES = 4;
+  const float ONE_MINUS_EPSILON = 0.99999994f;
+
+  float sinFromCos(float c)
+  {
+    return sqrtf(std::max(0.0f, 1.0f - c * c));
+  }
+
+  float safeAcos(float c)
+  {
+    return std::acos(std::min(1.0f, std::max(-1.0f, c)));
+  }
+
+  //Measure of the directions lit by a cone of normals with a cosine falloff
+  //(the orientation term of the surface area orientation heuristic)
+  float orientationMeasure(float cosTheta)
+  {
+    float thetaO = safeAcos(cosTheta);
+    float thetaW = std::min(thetaO + 0.5f * PI, PI);
+    float sinTheta = sinFromCos(cosTheta);
+    return 2.0f * PI * (1.0f - cosTheta) +
+           0.5f * PI * (2.0f * thetaW * sinTheta - std::cos(thetaO - 2.0f * thetaW) - 2.0f * thetaO * sinTheta + cosTheta);
+  }
+
+  float maxComponent(const Vector& v)
+  {
+    return std::max(v.x, std::max(v.y, v.z));
+  }
+}
+
+void LightBounds::extend(const LightBounds& other)
+{
+  if(other.power <= 0.0f) return;
+  if(power <= 0.0f)
+  {
+    *this = other;
+    return;
+  }
+
+  bounds.extend(other.bounds);
+  power += other.power;
+
+  //Smallest cone around both cones
+  float thetaA = safeAcos(cosTheta), thetaB = safeAcos(other.cosTheta);
+  float thetaD = safeAcos(axis.dot(other.axis));
+  if(std::min(thetaD + thetaB, PI) <= thetaA) return;
+  if(std::min(thetaD + thetaA, PI) <= thetaB)
+  {
+    axis = other.axis;
+    cosTheta = other.cosTheta;
+    return;
+  }
+
+  float thetaO = 0.5f * (thetaA + thetaD + thetaB);
+  Vector rotationAxis = axis.cross(other.axis);
+  if(thetaO >= PI || rotationAxis.lengthSq() == 0.0f)
+  {
+    cosTheta = -1.0f;
+    return;
+  }
+
+  //Rotate axis towards the other axis, rotationAxis is perpendicular to it
+  float thetaR = thetaO - thetaA;
+  rotationAxis.normalize();
+  axis = axis * std::cos(thetaR) + rotationAxis.cross(axis) * std::sin(thetaR);
+  axis.normalize();
+  cosTheta = std::cos(thetaO);
+}
+
+void LightTreeNode::setBounds(const LightBounds& lb)
+{
+  center = lb.bounds.getCenter();
+  radius = 0.5f * (lb.bounds.max - lb.bounds.min).length();
+  axis = lb.axis;
+  cosTheta = lb.cosTheta;
+  sinTheta = sinFromCos(lb.cosTheta);
+  power = lb.power;
+}
+
+float LightTreeNode::importance(const Vector& point, const Vector& normal) const
+{
+  Vector toPoint = point - center;
+  float distSq = toPoint.lengthSq();
+  if(distSq <= radius * radius)
+  {
+    //Inside the bounds every direction is possible
+    return power / std::max(radius * radius, 1e-12f);
+  }
+
+  float invDist = 1.0f / sqrtf(distSq);
+  //Angle under which the bounds are seen from the point
+  float sinBounds = radius * invDist;
+  float cosBounds = sinFromCos(sinBounds);
+
+  //Smallest angle between an emitting normal and the direction to the point:
+  //the angle to the axis less the cone and the bounds
+  float cosW = axis.dot(toPoint) * invDist;
+  float cosEmit = 1.0f;
+  if(cosW < cosTheta)
+  {
+    float sinW = sinFromCos(cosW);
+    cosEmit = cosW * cosTheta + sinW * sinTheta;
+    float sinEmit = sinW * cosTheta - cosW * sinTheta;
+    if(cosEmit < cosBounds) cosEmit = cosEmit * cosBounds + sinEmit * sinBounds;
+    else cosEmit = 1.0f;
+  }
+  if(cosEmit <= 0.0f) return 0.0f;
+
+  //Smallest angle between the receiving normal and the direction to the lights
+  float cosReceive = -normal.dot(toPoint) * invDist;
+  if(cosReceive < cosBounds) cosReceive = cosReceive * cosBounds + sinFromCos(cosReceive) * sinBounds;
+  else cosReceive = 1.0f;
+  if(cosReceive <= 0.0f) return 0.0f;
+
+  return power * cosEmit * cosReceive * invDist * invDist;
+}
+
+void LightTree::clear()
+{
+  m_lights.clear();
+  m_nodes.clear();
+  m_trails.clear();
+  m_lightIndices.clear();
+}
+
+LightBounds LightTree::getLightBounds(const Object& light)
+{
+  LightBounds lb;
+  lb.bounds = light.getBoundingBox();
+  light.getNormalBounds(lb.axis, lb.cosTheta);
+
+  float emittance = 0.0f;
+  for(int i = 0; i < POWER_SAMPLES; ++i)
+  {
+    for(int j = 0; j < POWER_SAMPLES; ++j)
+    {
+      SurfaceSample sample = light.getSample((i + 0.5f) / POWER_SAMPLES, (j + 0.5f) / POWER_SAMPLES);
+      float u, v;
+      light.getUVAt(sample.point, sample.primitive, u, v);
+      Vector e = light.material->getEmittance(u, v);
+      emittance += 0.2126f * e.x + 0.7152f * e.y + 0.0722f * e.z;
+    }
+  }
+  lb.power = emittance / (POWER_SAMPLES * POWER_SAMPLES) * light.getInversePDF();
+  return lb;
+}
+
+void LightTree::build(const std::vector<const Object*>& lights)
+{
+  clear();
+
+  std::vector<BuildEntry> entries;
+  for(const Object* light : lights)
+  {
+    BuildEntry entry;
+    entry.bounds = getLightBounds(*light);
+    if(!(entry.bounds.power > 0.0f)) continue;
+    entry.index = m_lights.size();
+    m_lights.push_back(light);
+    m_lightIndices[light] = entry.index;
+    entries.push_back(entry);
+  }
+  if(entries.empty()) return;
+
+  m_trails.resize(entries.size());
+  m_nodes.reserve(2 * entries.size());
+  m_nodes.push_back(LightTreeNode());
+  buildRecursive(entries, 0, 0, entries.size(), 0, 0);
+}
+
+void LightTree::buildRecursive(std::vector<BuildEntry>& entries, unsigned int nodeIndex, unsigned int begin, unsigned int end, uint64_t trail, unsigned int depth)
+{
+  if(end - begin == 1)
+  {
+    LightTreeNode& node = m_nodes[nodeIndex];
+    node.setBounds(entries[begin].bounds);
+    node.offset = entries[begin].index;
+    node.leaf = true;
+    m_trails[node.offset] = trail | (1ull << depth);
+    return;
+  }
+
+  LightBounds bounds;
+  AABB centroidBounds;
+  for(unsigned int i = begin; i < end; ++i)
+  {
+    bounds.extend(entries[i].bounds);
+    centroidBounds.extend(entries[i].bounds.bounds.getCenter());
+  }
+  m_nodes[nodeIndex].setBounds(bounds);
+  m_nodes[nodeIndex].leaf = false;
+
+  //Binned surface area orientation heuristic over all three axes
+  Vector diagonal = bounds.bounds.max - bounds.bounds.min;
+  float bestCost = std::numeric_limits<float>::max();
+  int bestAxis = -1, bestBucket = -1;
+  auto bucketOf = [&](const BuildEntry& e, int axis)
+  {
+    float extent = centroidBounds.max[axis] - centroidBounds.min[axis];
+    int b = (int)(SAOH_BUCKETS * (e.bounds.bounds.getCenter()[axis] - centroidBounds.min[axis]) / extent);
+    return std::min(SAOH_BUCKETS - 1, std::max(0, b));
+  };
+
+  for(int axis = 0; depth < MAX_SAOH_DEPTH && axis < 3; ++axis)
+  {
+    if(centroidBounds.max[axis] - centroidBounds.min[axis] <= 0.0f) continue;
+    //Penalizes thin slabs, whose cost the surface area alone underestimates
+    float regularization = diagonal[axis] > 0.0f ? maxComponent(diagonal) / diagonal[axis] : 1.0f;
+    auto cost = [&](const LightBounds& b)
+    {
+      return b.power * orientationMeasure(b.cosTheta) * b.bounds.getSurfaceArea() * regularization;
+    };
+
+    LightBounds buckets[SAOH_BUCKETS];
+    for(unsigned int i = begin; i < end; ++i)
+      buckets[bucketOf(entries[i], axis)].extend(entries[i].bounds);
+
+    float rightCost[SAOH_BUCKETS];
+    LightBounds accumulated;
+    for(int b = SAOH_BUCKETS - 1; b > 0; --b)
+    {
+      accumulated.extend(buckets[b]);
+      rightCost[b] = accumulated.power > 0.0f ? cost(accumulated) : -1.0f;
+    }
+
+    accumulated = LightBounds();
+    for(int b = 1; b < SAOH_BUCKETS; ++b)
+    {
+      accumulated.extend(buckets[b - 1]);
+      if(accumulated.power <= 0.0f || rightCost[b] < 0.0f) continue;
+      float splitCost = cost(accumulated) + rightCost[b];
+      if(splitCost < bestCost)
+      {
+        bestCost = splitCost;
+        bestAxis = axis;
+        bestBucket = b;
+      }
+    }
+  }
+
+  unsigned int mid = begin;
+  BuildEntry* first = entries.data() + begin;
+  if(bestAxis >= 0)
+  {
+    BuildEntry* pivot = std::partition(first, entries.data() + end, [&](const BuildEntry& e) { return bucketOf(e, bestAxis) < bestBucket; });
+    mid = begin + (pivot - first);
+  }
+
+  //Median split for coincident centroids and very deep nodes
+  if(mid == begin || mid == end)
+  {
+    int axis = centroidBounds.getLongestAxis();
+    mid = begin + (end - begin) / 2;
+    std::nth_element(first, entries.data() + mid, entries.data() + end, [axis](const BuildEntry& a, const BuildEntry& b)
+    {
+      return a.bounds.bounds.getCenter()[axis] < b.bounds.bounds.getCenter()[axis];
+    });
+  }
+
+  unsigned int left = m_nodes.size();
+  m_nodes.push_back(LightTreeNode());
+  buildRecursive(entries, left, begin, mid, trail, depth + 1);
+
+  unsigned int right = m_nodes.size();
+  m_nodes.push_back(LightTreeNode());
+  m_nodes[nodeIndex].offset = right;
+  buildRecursive(entries, right, mid, end, trail | (1ull << depth), depth + 1);
+}
+
+const Object* LightTree::sample(const Vector& point, const Vector& normal, float& u, float& pmf) const
+{
+  pmf = 0.0f;
+  if(m_nodes.empty()) return nullptr;
+
+  unsigned int current = 0;
+  float probability = 1.0f;
+  for(;;)
+  {
+    const LightTreeNode& node = m_nodes[current];
+    if(node.leaf)
+    {
+      pmf = probability;
+      return m_lights[node.offset];
+    }
+
+    float first = m_nodes[current + 1].importance(point, normal);
+    float second = m_nodes[node.offset].importance(point, normal);
+    if(first <= 0.0f && second <= 0.0f) return nullptr;
+
+    float p = first / (first + second);
+    if(u < p)
+    {
+      u = std::min(u / p, ONE_MINUS_EPSILON);
+      probability *= p;
+      current = current + 1;
+    }
+    else
+    {
+      u = std::min((u - p) / (1.0f - p), ONE_MINUS_EPSILON);
+      probability *= 1.0f - p;
+      current = node.offset;
+    }
+  }
+}
+
+float LightTree::getPMF(const Vector& point, const Vector& normal, const Object* light) const
+{
+  std::unordered_map<const Object*, unsigned int>::const_iterator it = m_lightIndices.find(light);
+  if(it == m_lightIndices.end()) return 0.0f;
+
+  uint64_t trail = m_trails[it->second];
+  unsigned int current = 0;
+  float probability = 1.0f;
+  while(trail != 1)
+  {
+    const LightTreeNode& node = m_nodes[current];
+    float first = m_nodes[current + 1].importance(point, normal);
+    float second = m_nodes[node.offset].importance(point, normal);
+    if(first <= 0.0f && second <= 0.0f) return 0.0f;
+
+    float p = first / (first + second);
+    if(trail & 1)
+    {
+      probability *= 1.0f - p;
+      current = node.offset;
+    }
+    else
+    {
+      probability *= p;
+      current = current + 1;
+    }
+    trail >>= 1;
+  }
+  return probability;
+}
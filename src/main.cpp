@@ -1,96 +1,417 @@
+#include <algorithm>
 #include <iostream>
 #include <memory>
 #include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define PATHTRACER_FORK
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
 
 #include "utils.hpp"
 #include "renderer.hpp"
 #include "camera.hpp"
 #include "scene.hpp"
 #include "texture.hpp"
+#include "textureRegistry.hpp"
 #include "solidMaterial.hpp"
 #include "texturedMaterial.hpp"
 #include "rectangle.hpp"
 #include "sphere.hpp"
+#include "group.hpp"
+#include "instance.hpp"
+#include "transform.hpp"
+#include "film.hpp"
+#include "sceneFile.hpp"
+#include "renderJob.hpp"
+#include "tileScheduler.hpp"
 
-int main()
+namespace
+{
+  //The scene rendered unless one is loaded with --scene
+  void createRoom(Scene& scene)
+  {
+    TextureRegistry textures;
+    Texture wallTexture = textures.get("textures/uv.ppm", true);
+    Texture wallTexture2 = textures.get("textures/uv.ppm", false);
+    Texture floorTexture = textures.get("textures/floor.ppm");
+    std::shared_ptr<BaseMaterial> wallMaterial1 = std::make_shared<TexturedMaterial>(wallTexture, 0.81f);
+    std::shared_ptr<BaseMaterial> wallMaterial2 = std::make_shared<TexturedMaterial>(wallTexture2, 0.81f);
+    std::shared_ptr<BaseMaterial> floorMaterial = std::make_shared<SolidMaterial>(Vector(1.0f, 1.0f, 1.0f), 0.81f);
+    std::shared_ptr<BaseMaterial> floorMaterial2 = std::make_shared<TexturedMaterial>(floorTexture, 0.81f);
+    std::shared_ptr<BaseMaterial> ceilingMaterial = std::make_shared<TexturedMaterial>(floorTexture, 0.0f, wallTexture2, 0.6);
+    std::shared_ptr<BaseMaterial> lampMaterial = std::make_shared<SolidMaterial>(Vector(1, 1, 1), 0.1, Vector(5, 5, 5));
+
+    scene.addObject(std::make_shared<Rectangle>(Vector(-2, -1, -1), Vector(1, 0, 0), Vector(0, 0, 1), Vector(0, 1, 0), 3, 3, wallMaterial1));
+    scene.addObject(std::make_shared<Rectangle>(Vector(2, 2, 2), Vector(-1, 0, 0), Vector(0, 0, -1), Vector(0, -1, 0), 3, 3, wallMaterial2));
+    scene.addObject(std::make_shared<Rectangle>(Vector(-2, -1, -1), Vector(0, 1, 0), Vector(1, 0, 0), Vector(0, 0, 1), 4, 3, floorMaterial2));
+    scene.addObject(std::make_shared<Rectangle>(Vector(-2, 2, -1), Vector(0, -1, 0), Vector(1, 0, 0), Vector(0, 0, 1), 4, 3, floorMaterial));
+    scene.addObject(std::make_shared<Rectangle>(Vector(-2, -1, 2), Vector(0, 0, -1), Vector(1, 0, 0), Vector(0, 1, 0), 4, 3, floorMaterial));
+    scene.addObject(std::make_shared<Rectangle>(Vector(-2, -1, -1), Vector(0, 0, 1), Vector(1, 0, 0), Vector(0, 1, 0), 4, 3, floorMaterial));
+    scene.addObject(std::make_shared<Sphere>(Vector(-0.8f, -0.5f, 0.8f), 0.5f, floorMaterial));
+    scene.addObject(std::make_shared<Sphere>(Vector(0.6f, -0.5f, 0.3f), 0.5f, floorMaterial));
+
+    //Lamp housing, built around its own origin and placed with an instance
+    std::vector<std::shared_ptr<Object>> housing;
+    housing.push_back(std::make_shared<Rectangle>(
+      Vector(-0.7f, 0.0f, 0.2f),
+      Vector(-1, 0, 0),
+      Vector(0, 0, -1),
+      0.4f, 0.12f,
+      floorMaterial
+    ));
+    housing.push_back(std::make_shared<Rectangle>(
+      Vector(0.7f, 0.0f, 0.2f),
+      Vector(1, 0, 0),
+      Vector(0, 0, -1),
+      0.4f, 0.12f,
+      floorMaterial
+    ));
+    housing.push_back(std::make_shared<Rectangle>(
+      Vector(-0.7f, 0.0f, 0.2f),
+      Vector(0, 0, 1),
+      Vector(1, 0, 0),
+      1.2f, 0.12f,
+      floorMaterial
+    ));
+    housing.push_back(std::make_shared<Rectangle>(
+      Vector(-0.7f, 0.0f, -0.2f),
+      Vector(0, 0, -1),
+      Vector(1, 0, 0),
+      1.2f, 0.12f,
+      floorMaterial
+    ));
+    housing.push_back(std::make_shared<Rectangle>(
+      Vector(-0.7f, -0.12f, -0.2f),
+      Vector(0, -1, 0),
+      Vector(1, 0, 0),
+      1.4f, 0.4f,
+      floorMaterial
+    ));
+    std::shared_ptr<Group> lampHousing = std::make_shared<Group>(housing);
+    scene.addObject(std::make_shared<Instance>(lampHousing, Transform::translation(Vector(0.0f, 2.0f, 1.1f))));
+    scene.addObject(std::make_shared<Rectangle>(
+      Vector(-0.6f, 1.849999f, 0.9f),
+      Vector(0, -1, 0),
+      Vector(1, 0, 0),
+      1.2f, 0.3f,
+      lampMaterial
+    ));
+  }
+
+  //Keeps the claim on a job alive from a thread of its own while the job renders
+  class ClaimHeartbeat
+  {
+  private:
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    bool m_stopped;
+    std::thread m_thread;
+  public:
+    ClaimHeartbeat(JobQueue& queue, const std::string& partialFile): m_stopped(false)
+    {
+      std::chrono::milliseconds interval((long long)(std::max(queue.CLAIM_TIMEOUT / 4.0f, 1.0f) * 1000.0f));
+      m_thread = std::thread([this, &queue, partialFile, interval]()
+      {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while(!m_wake.wait_for(lock, interval, [this]() { return m_stopped; }))
+          queue.keepAlive(partialFile);
+      });
+    }
+    ~ClaimHeartbeat()
+    {
+      {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopped = true;
+      }
+      m_wake.notify_one();
+      m_thread.join();
+    }
+  };
+
+  void printUsage(const char* program)
+  {
+    std::cout << "Usage: " << program << " [--scene file] [checkpoint]\n"
+              << "       " << program << " [--scene file] --stream [width height]\n"
+              << "       " << program << " [--scene file] --distribute directory processes [tileSize [samplesPerJob]]\n"
+              << "       " << program << " [--scene file] --worker directory\n"
+              << "       " << program << " [--scene file] --job x0 y0 x1 y1 firstSample lastSample partial.film\n";
+  }
+
+  //Parses a decimal number in [minValue, maxValue], false for signs, other characters
+  //or values out of range
+  bool parseCount(const char* text, unsigned long minValue, unsigned long maxValue, unsigned int& value)
+  {
+    if(*text < '0' || *text > '9') return false;
+    char* end;
+    errno = 0;
+    unsigned long parsed = std::strtoul(text, &end, 10);
+    if(*end != '\0' || errno == ERANGE || parsed < minValue || parsed > maxValue) return false;
+    value = (unsigned int)parsed;
+    return true;
+  }
+
+  //Renders jobs of queue into their partial films until none is pending
+  bool runWorker(Renderer& renderer, const Scene& scene, const Camera& camera, JobQueue& queue)
+  {
+    RenderJob job;
+    std::string partialFile;
+    Film film;
+    while(queue.claim(job, partialFile))
+    {
+      std::cout << "Job " << partialFile << ": pixels " << job.x0 << "," << job.y0 << " to " << job.x1 << "," << job.y1
+                << ", samples " << job.firstSample << " to " << job.lastSample << "\n";
+      renderer.reset(job.width, job.height);
+      bool rendered;
+      {
+        ClaimHeartbeat heartbeat(queue, partialFile);
+        rendered = renderer.renderJob(scene, camera, job, film);
+      }
+      if(!rendered) return false;
+      if(!film.save(partialFile.c_str()))
+      {
+        std::cout << "ERROR: Partial film (" << partialFile << ") could not be saved!\n";
+        return false;
+      }
+      queue.complete(partialFile);
+    }
+    return true;
+  }
+
+  //Splits the frame into jobs in directory, renders them in local worker processes (and
+  //any started elsewhere with --worker) and merges their partial films into film
+  bool distribute(Renderer& renderer, const Scene& scene, const Camera& camera, const char* directory, unsigned int processes, unsigned int tileSize, unsigned int samplesPerJob, Film& film)
+  {
+    JobQueue queue(directory);
+    if(!queue.create(splitFrame(renderer.getWidth(), renderer.getHeight(), renderer.MC_SAMPLES, tileSize, samplesPerJob)))
+      return false;
+    std::cout << queue.getJobCount() << " jobs in " << directory << "\n";
+
+#ifdef PATHTRACER_FORK
+    //Workers are copies of this process, the scene is loaded once
+    if(renderer.THREADS == 0)
+      renderer.THREADS = std::max(1u, TileScheduler::getDefaultThreadCount() / std::max(processes, 1u));
+    std::vector<pid_t> workers;
+    //Children would write the output still buffered here once more
+    std::cout.flush();
+    for(unsigned int i = 0; i < processes; ++i)
+    {
+      pid_t pid = fork();
+      if(pid == 0)
+      {
+        JobQueue workerQueue(directory);
+        bool done = runWorker(renderer, scene, camera, workerQueue);
+        std::cout.flush();
+        std::_Exit(done ? 0 : 1);
+      }
+      if(pid > 0) workers.push_back(pid);
+    }
+    for(size_t i = 0; i < workers.size(); ++i)
+    {
+      int status;
+      waitpid(workers[i], &status, 0);
+      if(!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+      {
+        size_t released = queue.release(JobQueue::getWorkerName(workers[i]));
+        std::cout << "ERROR: Worker " << workers[i] << " failed, " << released << " jobs are rendered again!\n";
+      }
+    }
+#else
+    (void)processes;
+#endif
+
+    //Jobs released by failed workers and left over by others are rendered here,
+    //claims of workers elsewhere which stopped keeping them alive are released
+    size_t jobCount = queue.getJobCount();
+    while(queue.getPartials().size() < jobCount)
+    {
+      size_t stale = queue.releaseStale();
+      if(stale > 0)
+        std::cout << "ERROR: " << stale << " jobs of workers which stopped responding are rendered again!\n";
+
+      size_t failed = queue.getFailedCount();
+      if(failed > 0)
+      {
+        std::cout << "ERROR: " << failed << " jobs in " << directory << "/failed could not be read!\n";
+        return false;
+      }
+
+      //Workers save the partial film before deleting the claim, so it is counted last
+      size_t pending = queue.getPendingCount();
+      size_t running = queue.getRunningCount();
+      if(pending > 0)
+      {
+        if(!runWorker(renderer, scene, camera, queue)) return false;
+      }
+      else if(running == 0 && queue.getPartials().size() < jobCount)
+      {
+        std::cout << "ERROR: " << jobCount - queue.getPartials().size() << " jobs are neither pending, running nor done!\n";
+        return false;
+      }
+      else
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+    }
+    return mergePartials(queue.getPartials(), film);
+  }
+}
+
+//PathTracer [--scene file] [checkpoint] -- with a checkpoint file the image is rendered
+//progressively, saved to it periodically and resumed from it when it already exists
+//PathTracer [--scene file] --stream [width height] -- renders the image in bands, each
+//written to the output files when it is done, for images too large to keep in memory
+//PathTracer [--scene file] --distribute directory processes [tileSize [samplesPerJob]] --
+//splits the image into jobs in directory, renders them in that many worker processes and
+//merges the results (tileSize defaults to 128, samplesPerJob to all samples)
+//PathTracer [--scene file] --worker directory -- renders jobs of a distributed render
+//PathTracer [--scene file] --job x0 y0 x1 y1 firstSample lastSample partial.film -- renders
+//a rectangle of the image and a range of its samples, PathTracerMerge combines the results
+//--scene renders a scene compiled by PathTracerSceneCompiler instead of the built-in one
+int main(int argc, char** argv)
 {
   int width = 600, height = 600;
   char *pixels = nullptr;
+  int arg = 1;
+  const char* sceneFile = nullptr;
+  if(argc > arg + 1 && std::strcmp(argv[arg], "--scene") == 0)
+  {
+    sceneFile = argv[arg + 1];
+    arg += 2;
+  }
+  bool streaming = argc > arg && std::strcmp(argv[arg], "--stream") == 0;
+  bool distributed = argc > arg && std::strcmp(argv[arg], "--distribute") == 0;
+  bool worker = argc > arg && std::strcmp(argv[arg], "--worker") == 0;
+  bool job = argc > arg && std::strcmp(argv[arg], "--job") == 0;
+  //Options missing operands must not be taken for a checkpoint file
+  int operands = argc - arg - 1;
+  bool valid;
+  if(streaming) valid = operands == 0 || operands == 2;
+  else if(distributed) valid = operands >= 2 && operands <= 4;
+  else if(worker) valid = operands == 1;
+  else if(job) valid = operands == 7;
+  else valid = argc == arg || (operands == 0 && std::strncmp(argv[arg], "--", 2) != 0);
+  if(!valid)
+  {
+    printUsage(argv[0]);
+    return 1;
+  }
+  if(streaming && argc > arg + 2)
+  {
+    width = std::atoi(argv[arg + 1]);
+    height = std::atoi(argv[arg + 2]);
+    if(width <= 0 || height <= 0)
+    {
+      std::cout << "ERROR: Invalid image size (" << argv[arg + 1] << "x" << argv[arg + 2] << ")!\n";
+      return 1;
+    }
+  }
 
   Renderer renderer(width, height);
   renderer.MC_SAMPLES = 32;
-  renderer.LIGHT_SAMPLES = 32;
+  renderer.LIGHT_SAMPLES = 4;
+
+  //Every local worker renders with at least one thread, more processes than a few per
+  //hardware thread only compete for memory
+  unsigned int processes = 0, tileSize = 128, samplesPerJob = 0;
+  if(distributed)
+  {
+    unsigned int maxProcesses = 4 * TileScheduler::getDefaultThreadCount();
+    unsigned int maxTileSize = std::max(width, height);
+    if(!parseCount(argv[arg + 2], 1, maxProcesses, processes) ||
+       (argc > arg + 3 && !parseCount(argv[arg + 3], 1, maxTileSize, tileSize)) ||
+       (argc > arg + 4 && !parseCount(argv[arg + 4], 1, renderer.MC_SAMPLES, samplesPerJob)))
+    {
+      std::cout << "ERROR: Invalid distribution (processes 1 to " << maxProcesses << ", tile size 1 to "
+                << maxTileSize << ", samples per job 1 to " << renderer.MC_SAMPLES << ")!\n";
+      printUsage(argv[0]);
+      return 1;
+    }
+  }
+  RenderJob part;
+  if(job)
+  {
+    part.width = width;
+    part.height = height;
+    part.samples = renderer.MC_SAMPLES;
+    unsigned int* values[] = {&part.x0, &part.y0, &part.x1, &part.y1, &part.firstSample, &part.lastSample};
+    for(int i = 0; i < 6; ++i)
+    {
+      if(!parseCount(argv[arg + 1 + i], 0, std::numeric_limits<unsigned int>::max(), *values[i]))
+      {
+        std::cout << "ERROR: Invalid job operand (" << argv[arg + 1 + i] << ")!\n";
+        printUsage(argv[0]);
+        return 1;
+      }
+    }
+  }
 
   Camera camera(90, Vector(0, 0, -1), Vector(0, 0, 1), Vector(0, 1, 0));
   Scene scene;
-  Texture wallTexture("textures/uv.ppm", true);
-  Texture wallTexture2("textures/uv.ppm", false);
-  Texture floorTexture("textures/floor.ppm");
-  std::shared_ptr<BaseMaterial> wallMaterial1 = std::make_shared<TexturedMaterial>(wallTexture, 0.81f);
-  std::shared_ptr<BaseMaterial> wallMaterial2 = std::make_shared<TexturedMaterial>(wallTexture2, 0.81f);
-  std::shared_ptr<BaseMaterial> floorMaterial = std::make_shared<SolidMaterial>(Vector(1.0f, 1.0f, 1.0f), 0.81f);
-  std::shared_ptr<BaseMaterial> floorMaterial2 = std::make_shared<TexturedMaterial>(floorTexture, 0.81f);
-  std::shared_ptr<BaseMaterial> ceilingMaterial = std::make_shared<TexturedMaterial>(floorTexture, 0.0f, wallTexture2, 0.6);
-  std::shared_ptr<BaseMaterial> lampMaterial = std::make_shared<SolidMaterial>(Vector(1, 1, 1), 0.1, Vector(5, 5, 5));
-
-  scene.addObject(std::make_shared<Rectangle>(Vector(-2, -1, -1), Vector(1, 0, 0), Vector(0, 0, 1), Vector(0, 1, 0), 3, 3, wallMaterial1));
-  scene.addObject(std::make_shared<Rectangle>(Vector(2, 2, 2), Vector(-1, 0, 0), Vector(0, 0, -1), Vector(0, -1, 0), 3, 3, wallMaterial2));
-  scene.addObject(std::make_shared<Rectangle>(Vector(-2, -1, -1), Vector(0, 1, 0), Vector(1, 0, 0), Vector(0, 0, 1), 4, 3, floorMaterial2));
-  scene.addObject(std::make_shared<Rectangle>(Vector(-2, 2, -1), Vector(0, -1, 0), Vector(1, 0, 0), Vector(0, 0, 1), 4, 3, floorMaterial));
-  scene.addObject(std::make_shared<Rectangle>(Vector(-2, -1, 2), Vector(0, 0, -1), Vector(1, 0, 0), Vector(0, 1, 0), 4, 3, floorMaterial));
-  scene.addObject(std::make_shared<Rectangle>(Vector(-2, -1, -1), Vector(0, 0, 1), Vector(1, 0, 0), Vector(0, 1, 0), 4, 3, floorMaterial));
-  scene.addObject(std::make_shared<Sphere>(Vector(-0.8f, -0.5f, 0.8f), 0.5f, floorMaterial));
-  scene.addObject(std::make_shared<Sphere>(Vector(0.6f, -0.5f, 0.3f), 0.5f, floorMaterial));
-
-  scene.addObject(std::make_shared<Rectangle>(
-    Vector(-0.7f, 2.0f, 1.3f),
-    Vector(-1, 0, 0),
-    Vector(0, 0, -1),
-    0.4f, 0.12f,
-    floorMaterial
-  ));
-  scene.addObject(std::make_shared<Rectangle>(
-    Vector(0.7f, 2.0f, 1.3f),
-    Vector(1, 0, 0),
-    Vector(0, 0, -1),
-    0.4f, 0.12f,
-    floorMaterial
-  ));
-  scene.addObject(std::make_shared<Rectangle>(
-    Vector(-0.7f, 2.0f, 1.3f),
-    Vector(0, 0, 1),
-    Vector(1, 0, 0),
-    1.2f, 0.12f,
-    floorMaterial
-  ));
-  scene.addObject(std::make_shared<Rectangle>(
-    Vector(-0.7f, 2.0f, 0.9f),
-    Vector(0, 0, -1),
-    Vector(1, 0, 0),
-    1.2f, 0.12f,
-    floorMaterial
-  ));
-  scene.addObject(std::make_shared<Rectangle>(
-    Vector(-0.7f, 1.88f, 0.9f),
-    Vector(0, -1, 0),
-    Vector(1, 0, 0),
-    1.4f, 0.4f,
-    floorMaterial
-  ));
-  scene.addObject(std::make_shared<Rectangle>(
-    Vector(-0.6f, 1.849999f, 0.9f),
-    Vector(0, -1, 0),
-    Vector(1, 0, 0),
-    1.2f, 0.3f,
-    lampMaterial
-  ));
+  if(sceneFile)
+  {
+    if(!loadCompiledScene(sceneFile, scene, camera)) return 1;
+  }
+  else
+  {
+    createRoom(scene);
+    scene.build();
+  }
 
   std::cout << "Rendering...\n";
 
   std::chrono::time_point<std::chrono::system_clock> start, end;
   start = std::chrono::system_clock::now();
 
-  renderer.render(scene, camera, pixels);
+  Film film;
+  bool saved = true;
+  //Workers and jobs write partial films only
+  bool partial = worker || job;
+  if(streaming)
+    saved = renderer.renderStreaming(scene, camera, "render.ppm", "render.pfm");
+  else if(distributed)
+  {
+    if(!distribute(renderer, scene, camera, argv[arg + 1], processes, tileSize, samplesPerJob, film))
+      return 1;
+  }
+  else if(worker)
+  {
+    JobQueue queue(argv[arg + 1]);
+    saved = runWorker(renderer, scene, camera, queue);
+  }
+  else if(job)
+  {
+    const char* partialFile = argv[arg + 7];
+    saved = renderer.renderJob(scene, camera, part, film);
+    if(saved && !film.save(partialFile))
+    {
+      std::cout << "ERROR: Partial film (" << partialFile << ") could not be saved!\n";
+      saved = false;
+    }
+  }
+  else if(argc > arg)
+  {
+    const char* checkpoint = argv[arg];
+    if(film.load(checkpoint))
+      std::cout << "Resuming from " << checkpoint << " (" << film.getMinSampleCount() << " samples per pixel)\n";
+    else
+      film.reset(width, height, renderer.SEED);
+
+    if(!renderer.renderProgressive(scene, camera, film, renderer.MC_SAMPLES, checkpoint))
+      return 1;
+  }
+  else
+    renderer.render(scene, camera, film);
+  if(!streaming && !partial)
+    renderer.tonemap(film, pixels);
 
   end = std::chrono::system_clock::now();
   std::chrono::duration<double> elapsed = end-start;
@@ -105,7 +426,16 @@ int main()
   if(min > 0) std::cout << min << "m ";
   std::cout << sec << "s\n";
 
-  savePPM("render.ppm", width, height, pixels);
+  if(!streaming && !partial)
+  {
+    savePPM("render.ppm", width, height, pixels);
+    //Linear radiance, PathTracerTonemap turns it into other PPMs without rendering again
+    if(!film.savePFM("render.pfm"))
+    {
+      std::cout << "ERROR: HDR image (render.pfm) could not be saved!\n";
+      saved = false;
+    }
+  }
   delete[] pixels;
-  return 0;
+  return saved ? 0 : 1;
 }
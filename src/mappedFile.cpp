@@ -0,0 +1,79 @@
+#include "mappedFile.hpp"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define PATHTRACER_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#include <fstream>
+#include <iterator>
+#endif
+
+MappedFile::MappedFile(const char* fileName): m_data(nullptr), m_size(0)
+{
+#ifdef PATHTRACER_MMAP
+  int fd = open(fileName, O_RDONLY);
+  if(fd < 0) return;
+
+  struct stat info;
+  if(fstat(fd, &info) == 0 && info.st_size > 0)
+  {
+    void* data = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if(data != MAP_FAILED)
+    {
+      //Images are parsed front to back
+      madvise(data, info.st_size, MADV_SEQUENTIAL);
+      m_data = (const uint8_t*)data;
+      m_size = info.st_size;
+    }
+  }
+  //The mapping stays valid without the descriptor
+  ::close(fd);
+#else
+  std::ifstream file(fileName, std::ios::binary);
+  if(!file.is_open()) return;
+  m_buffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+  if(!m_buffer.empty())
+  {
+    m_data = m_buffer.data();
+    m_size = m_buffer.size();
+  }
+#endif
+}
+
+MappedFile::MappedFile(MappedFile&& other): m_data(other.m_data), m_size(other.m_size), m_buffer(std::move(other.m_buffer))
+{
+  other.m_data = nullptr;
+  other.m_size = 0;
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other)
+{
+  if(this != &other)
+  {
+    close();
+    m_data = other.m_data;
+    m_size = other.m_size;
+    m_buffer = std::move(other.m_buffer);
+    other.m_data = nullptr;
+    other.m_size = 0;
+  }
+  return *this;
+}
+
+MappedFile::~MappedFile()
+{
+  close();
+}
+
+void MappedFile::close()
+{
+#ifdef PATHTRACER_MMAP
+  if(m_data) munmap((void*)m_data, m_size);
+#endif
+  m_buffer.clear();
+  m_data = nullptr;
+  m_size = 0;
+}
@@ -0,0 +1,195 @@
+#include "objLoader.hpp"
+
+#include <fstream>
+#include <string>
+#include <cstdlib>
+#include <unordered_map>
+
+#include "triangleMesh.hpp"
+
+namespace
+{
+  struct VertexKey
+  {
+    int position, uv, normal;
+
+    bool operator==(const VertexKey& other) const
+    {
+      return position == other.position && uv == other.uv && normal == other.normal;
+    }
+  };
+
+  struct VertexKeyHash
+  {
+    size_t operator()(const VertexKey& key) const
+    {
+      size_t h = (size_t)key.position * 73856093u;
+      h ^= (size_t)(key.uv + 1) * 19349663u;
+      h ^= (size_t)(key.normal + 1) * 83492791u;
+      return h;
+    }
+  };
+
+  //OBJ indices start at 1, negative ones count back from the last element
+  bool resolveIndex(long index, size_t count, int& result)
+  {
+    if(index > 0) index -= 1;
+    else if(index < 0) index += count;
+    else return false;
+    if(index < 0 || (size_t)index >= count) return false;
+    result = index;
+    return true;
+  }
+
+  bool parseFaceVertex(const char*& s, size_t positions, size_t uvs, size_t normals, VertexKey& key)
+  {
+    char* end;
+    long index = std::strtol(s, &end, 10);
+    if(end == s || !resolveIndex(index, positions, key.position)) return false;
+    s = end;
+    key.uv = -1;
+    key.normal = -1;
+
+    if(*s == '/')
+    {
+      ++s;
+      if(*s != '/')
+      {
+        index = std::strtol(s, &end, 10);
+        if(end == s || !resolveIndex(index, uvs, key.uv)) return false;
+        s = end;
+      }
+      if(*s == '/')
+      {
+        ++s;
+        index = std::strtol(s, &end, 10);
+        if(end == s || !resolveIndex(index, normals, key.normal)) return false;
+        s = end;
+      }
+    }
+    return true;
+  }
+
+  const char* skipSpaces(const char* s)
+  {
+    while(*s == ' ' || *s == '\t') ++s;
+    return s;
+  }
+}
+
+bool loadOBJ(const char* fileName, MeshData& mesh)
+{
+  std::ifstream file(fileName);
+  if(!file.is_open()) return false;
+
+  std::vector<Vector> positions;
+  std::vector<Vector> normals;
+  std::vector<float> uvs;
+  std::unordered_map<VertexKey, unsigned int, VertexKeyHash> vertices;
+  std::vector<VertexKey> keys;
+  std::vector<unsigned int> polygon;
+  bool hasUVs = false, hasNormals = false;
+
+  mesh = MeshData();
+  std::string line;
+  while(std::getline(file, line))
+  {
+    const char* s = skipSpaces(line.c_str());
+    char* end;
+    if(s[0] == 'v' && (s[1] == ' ' || s[1] == '\t'))
+    {
+      float x = std::strtof(s + 2, &end);
+      float y = std::strtof(end, &end);
+      float z = std::strtof(end, &end);
+      positions.push_back(Vector(x, y, z));
+    }
+    else if(s[0] == 'v' && s[1] == 't')
+    {
+      float u = std::strtof(s + 2, &end);
+      float v = std::strtof(end, &end);
+      uvs.push_back(u);
+      uvs.push_back(v);
+    }
+    else if(s[0] == 'v' && s[1] == 'n')
+    {
+      float x = std::strtof(s + 2, &end);
+      float y = std::strtof(end, &end);
+      float z = std::strtof(end, &end);
+      normals.push_back(Vector(x, y, z).normalize());
+    }
+    else if(s[0] == 'f' && (s[1] == ' ' || s[1] == '\t'))
+    {
+      polygon.clear();
+      s = skipSpaces(s + 2);
+      while(*s && *s != '\r' && *s != '#')
+      {
+        VertexKey key;
+        if(!parseFaceVertex(s, positions.size(), uvs.size() / 2, normals.size(), key)) return false;
+        hasUVs = hasUVs || key.uv >= 0;
+        hasNormals = hasNormals || key.normal >= 0;
+
+        auto it = vertices.find(key);
+        if(it == vertices.end())
+        {
+          it = vertices.insert(std::make_pair(key, (unsigned int)keys.size())).first;
+          keys.push_back(key);
+        }
+        polygon.push_back(it->second);
+        s = skipSpaces(s);
+      }
+
+      for(size_t i = 2; i < polygon.size(); ++i)
+      {
+        mesh.indices.push_back(polygon[0]);
+        mesh.indices.push_back(polygon[i - 1]);
+        mesh.indices.push_back(polygon[i]);
+      }
+    }
+  }
+
+  mesh.positions.resize(keys.size());
+  if(hasNormals) mesh.normals.resize(keys.size());
+  if(hasUVs) mesh.uvs.resize(2 * keys.size());
+  for(size_t i = 0; i < keys.size(); ++i)
+  {
+    mesh.positions[i] = positions[keys[i].position];
+    if(hasNormals)
+      mesh.normals[i] = keys[i].normal >= 0 ? normals[keys[i].normal] : Vector(0, 0, 0);
+    if(hasUVs && keys[i].uv >= 0)
+    {
+      mesh.uvs[2*i] = uvs[2*keys[i].uv];
+      mesh.uvs[2*i + 1] = uvs[2*keys[i].uv + 1];
+    }
+  }
+
+  //Faces without normals in a file which has some get flat shading: each of their corners
+  //gets a vertex of its own with the normal of the triangle, interpolating the zero normals
+  //left above would give no normal at all
+  if(hasNormals)
+  {
+    for(size_t i = 0; i < mesh.indices.size(); i += 3)
+    {
+      unsigned int* tri = &mesh.indices[i];
+      if(keys[tri[0]].normal >= 0 && keys[tri[1]].normal >= 0 && keys[tri[2]].normal >= 0) continue;
+
+      const Vector& p0 = mesh.positions[tri[0]];
+      Vector normal = (mesh.positions[tri[1]] - p0).cross(mesh.positions[tri[2]] - p0).normalize();
+      for(int corner = 0; corner < 3; ++corner)
+      {
+        unsigned int vertex = tri[corner];
+        if(keys[vertex].normal >= 0) continue;
+        tri[corner] = mesh.positions.size();
+        mesh.positions.push_back(mesh.positions[vertex]);
+        mesh.normals.push_back(normal);
+        if(hasUVs)
+        {
+          float u = mesh.uvs[2*vertex], v = mesh.uvs[2*vertex + 1];
+          mesh.uvs.push_back(u);
+          mesh.uvs.push_back(v);
+        }
+      }
+    }
+  }
+
+  return !mesh.indices.empty();
+}
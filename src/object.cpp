@@ -1,4 +1,27 @@
 #include "object.hpp"
 #include "solidMaterial.hpp"
+#include "core.hpp"
 
-Object::Object(): material(new SolidMaterial()) {}
\ No newline at end of file
+Object::Object(): material(new SolidMaterial()) {}
+
+bool Object::occludes(const Ray& ray, float maxT) const
+{
+  float t = intersect(ray);
+  return t > 0.0f && (t < maxT || maxT < 0.0f);
+}
+
+SurfaceSample Object::getSampleFrom(const Vector& ref, float u1, float u2, float& pdf) const
+{
+  SurfaceSample sample = getSample(u1, u2);
+  pdf = Object::getPDFFrom(ref, sample.point, sample.primitive);
+  return sample;
+}
+
+float Object::getPDFFrom(const Vector& ref, const Vector& point, unsigned int primitive) const
+{
+  Vector toPoint = point - ref;
+  float distSq = toPoint.lengthSq();
+  float cosLight = -toPoint.dot(getNormalAt(point, primitive)) / sqrtf(distSq);
+  if(!(cosLight > 0.0f)) return 0.0f;
+  return distSq / (cosLight * getInversePDF());
+}
@@ -1,5 +1,6 @@
 #include "plane.hpp"
 #include "core.hpp"
+#include "aabb.hpp"
 
 float Plane::intersect(const Ray& ray) const
 {
@@ -9,12 +10,18 @@ float Plane::intersect(const Ray& ray) const
   return -(ray.origin - point).dot(this->normal) / don;
 }
 
-Vector Plane::getNormalAt(const Vector&) const
+//Planes are unbounded, scenes test them outside of their BVH
+AABB Plane::getBoundingBox() const
+{
+  return AABB();
+}
+
+Vector Plane::getNormalAt(const Vector&, unsigned int) const
 {
   return normal;
 }
 
-void Plane::getUVAt(const Vector&, float& u, float& v) const
+void Plane::getUVAt(const Vector&, unsigned int, float& u, float& v) const
 {
   u = 0;
   v = 0;
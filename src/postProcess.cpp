@@ -0,0 +1,256 @@
+#include "postProcess.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+
+#include "film.hpp"
+#include "tileScheduler.hpp"
+#include "utils.hpp"
+
+#ifdef PATHTRACER_X86_SIMD
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+  const size_t BLOCK_SIZE = 16384;
+
+  size_t getBlockCount(size_t count)
+  {
+    return (count + BLOCK_SIZE - 1) / BLOCK_SIZE;
+  }
+
+  //Calls f(block, first, last) for every block of BLOCK_SIZE pixels out of count on up to
+  //threads threads. Blocks do not depend on the number of threads, so reductions summing
+  //per block results in block order give the same value with any.
+  template<typename F>
+  void forEachBlock(size_t count, unsigned int threads, F f)
+  {
+    size_t blocks = getBlockCount(count);
+    std::atomic<size_t> next(0);
+    auto worker = [&]()
+    {
+      for(size_t block = next++; block < blocks; block = next++)
+        f(block, block * BLOCK_SIZE, std::min(count, (block + 1) * BLOCK_SIZE));
+    };
+
+    if(threads == 0) threads = TileScheduler::getDefaultThreadCount();
+    threads = std::max<size_t>(1, std::min<size_t>(threads, blocks));
+    std::vector<std::thread> pool;
+    for(unsigned int t = 1; t < threads; ++t)
+      pool.emplace_back(worker);
+    worker();
+    for(size_t t = 0; t < pool.size(); ++t)
+      pool[t].join();
+  }
+
+  //Y row of toXYZ
+  float luminance(const Vector& color)
+  {
+    return 0.21263682f * color.x + 0.71518298f * color.y + 0.07218020f * color.z;
+  }
+
+  const float SQRT2 = 1.41421356f;
+  const float LN2 = 0.693147181f;
+
+  //Natural logarithm of a positive finite x to about 1e-7. log(m) = 2 atanh(s) is summed
+  //for the mantissa m in [sqrt(1/2), sqrt(2)), where the series converges quickly.
+  //The SSE version below does the same operations in the same order.
+  float logPositive(float x)
+  {
+    uint32_t bits;
+    std::memcpy(&bits, &x, sizeof(bits));
+    int exponent = (int)(bits >> 23) - 127;
+    bits = (bits & 0x007fffffu) | 0x3f800000u;
+    float m;
+    std::memcpy(&m, &bits, sizeof(m));
+
+    if(m > SQRT2)
+    {
+      m *= 0.5f;
+      ++exponent;
+    }
+    float s = (m - 1.0f) / (m + 1.0f), s2 = s * s;
+    float series = s * (2.0f + s2 * (2.0f / 3.0f + s2 * (2.0f / 5.0f + s2 * (2.0f / 7.0f))));
+    return exponent * LN2 + series;
+  }
+
+#ifdef PATHTRACER_X86_SIMD
+  __m128 logPositive(__m128 x)
+  {
+    __m128i bits = _mm_castps_si128(x);
+    __m128i exponent = _mm_sub_epi32(_mm_srli_epi32(bits, 23), _mm_set1_epi32(127));
+    bits = _mm_or_si128(_mm_and_si128(bits, _mm_set1_epi32(0x007fffff)), _mm_set1_epi32(0x3f800000));
+    __m128 m = _mm_castsi128_ps(bits);
+
+    __m128 high = _mm_cmpgt_ps(m, _mm_set1_ps(SQRT2));
+    m = _mm_or_ps(_mm_and_ps(high, _mm_mul_ps(m, _mm_set1_ps(0.5f))), _mm_andnot_ps(high, m));
+    exponent = _mm_sub_epi32(exponent, _mm_castps_si128(high));
+    __m128 one = _mm_set1_ps(1.0f);
+    __m128 s = _mm_div_ps(_mm_sub_ps(m, one), _mm_add_ps(m, one)), s2 = _mm_mul_ps(s, s);
+    __m128 series = _mm_add_ps(_mm_set1_ps(2.0f / 5.0f), _mm_mul_ps(s2, _mm_set1_ps(2.0f / 7.0f)));
+    series = _mm_add_ps(_mm_set1_ps(2.0f / 3.0f), _mm_mul_ps(s2, series));
+    series = _mm_add_ps(_mm_set1_ps(2.0f), _mm_mul_ps(s2, series));
+    series = _mm_mul_ps(s, series);
+    return _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(exponent), _mm_set1_ps(LN2)), series);
+  }
+#endif
+
+  //Sum of the logarithms of the luminance of count pixels, kept in 4 lanes summed at the
+  //end so the scalar and the SSE code add in the same order
+  double sumLogLuminance(const Vector* pixels, size_t count)
+  {
+    const float EPSILON = 0.000001f;
+    size_t i = 0;
+    float lanes[4] = {};
+#ifdef PATHTRACER_X86_SIMD
+    __m128 sum = _mm_setzero_ps();
+    for(; i + 4 <= count; i += 4)
+    {
+      __m128 y = _mm_setr_ps(luminance(pixels[i]), luminance(pixels[i + 1]), luminance(pixels[i + 2]), luminance(pixels[i + 3]));
+      sum = _mm_add_ps(sum, logPositive(_mm_add_ps(y, _mm_set1_ps(EPSILON))));
+    }
+    _mm_storeu_ps(lanes, sum);
+#else
+    for(; i + 4 <= count; i += 4)
+    {
+      for(int k = 0; k < 4; ++k)
+        lanes[k] += logPositive(luminance(pixels[i + k]) + EPSILON);
+    }
+#endif
+    double result = 0.0;
+    for(; i < count; ++i)
+      result += logPositive(luminance(pixels[i]) + EPSILON);
+    for(int k = 0; k < 4; ++k)
+      result += lanes[k];
+    return result;
+  }
+
+  //Linear values at which the 8-bit sRGB code rounds up to the next one. Codes are found
+  //through buckets narrower than the smallest gap between thresholds, so at most one
+  //threshold separates the code at the start of a bucket from the right one.
+  struct SRGBEncodeTable
+  {
+    static const int BUCKETS = 4096;
+    float thresholds[256];
+    unsigned char buckets[BUCKETS];
+
+    SRGBEncodeTable()
+    {
+      for(int i = 0; i < 255; ++i)
+      {
+        thresholds[i] = (i + 0.5f) / 255.0f;
+        sRGBDecode(thresholds[i]);
+      }
+      thresholds[255] = 2.0f;
+      for(int i = 0; i < BUCKETS; ++i)
+        buckets[i] = std::upper_bound(thresholds, thresholds + 255, (float)i / (BUCKETS - 1)) - thresholds;
+    }
+  };
+  const SRGBEncodeTable SRGB_ENCODE;
+
+  //Without branches, which random colors mispredict
+  unsigned char toSRGB8(float c)
+  {
+    //NaN becomes 0 as well
+    c = c > 0.0f ? c : 0.0f;
+    c = c < 1.0f ? c : 1.0f;
+    int code = SRGB_ENCODE.buckets[(int)(c * (SRGBEncodeTable::BUCKETS - 1))];
+    return code + (c >= SRGB_ENCODE.thresholds[code]);
+  }
+}
+
+void ReinhardOperator::prepare(const std::vector<Vector>& image, unsigned int threads)
+{
+  m_scale = 1.0f;
+  if(image.empty()) return;
+
+  std::vector<double> sums(getBlockCount(image.size()));
+  forEachBlock(image.size(), threads, [&](size_t block, size_t first, size_t last)
+  {
+    sums[block] = sumLogLuminance(&image[first], last - first);
+  });
+
+  double sum = 0.0;
+  for(size_t i = 0; i < sums.size(); ++i)
+    sum += sums[i];
+  float logAverage = std::exp(sum / image.size());
+  m_scale = KEY / logAverage;
+}
+
+void ReinhardOperator::apply(Vector* pixels, size_t count) const
+{
+  //L / (1 + L) over the original luminance, with L = scale * luminance
+  for(size_t i = 0; i < count; ++i)
+    pixels[i] *= m_scale / (1.0f + m_scale * luminance(pixels[i]));
+}
+
+void PostProcess::addOperator(std::shared_ptr<PostOperator> op)
+{
+  m_operators.push_back(std::move(op));
+}
+
+void PostProcess::resolve(const Film& film, std::vector<Vector>& image) const
+{
+  unsigned int width = film.getWidth();
+  image.resize((size_t)width * film.getHeight());
+  forEachBlock(image.size(), THREADS, [&](size_t, size_t first, size_t last)
+  {
+    for(size_t i = first; i < last; ++i)
+      image[i] = film.getColor(i % width, i / width);
+  });
+}
+
+void PostProcess::apply(std::vector<Vector>& image) const
+{
+  for(size_t i = 0; i < m_operators.size(); ++i)
+  {
+    const std::shared_ptr<PostOperator>& op = m_operators[i];
+    op->prepare(image, THREADS);
+    forEachBlock(image.size(), THREADS, [&](size_t, size_t first, size_t last)
+    {
+      op->apply(&image[first], last - first);
+    });
+  }
+}
+
+void PostProcess::prepare(std::vector<Vector> preview) const
+{
+  //Every operator is prepared on the output of the ones before it
+  for(size_t i = 0; i < m_operators.size(); ++i)
+  {
+    const std::shared_ptr<PostOperator>& op = m_operators[i];
+    op->prepare(preview, THREADS);
+    if(i + 1 == m_operators.size()) break;
+    forEachBlock(preview.size(), THREADS, [&](size_t, size_t first, size_t last)
+    {
+      op->apply(&preview[first], last - first);
+    });
+  }
+}
+
+void PostProcess::applyPrepared(std::vector<Vector>& image) const
+{
+  forEachBlock(image.size(), THREADS, [&](size_t, size_t first, size_t last)
+  {
+    for(size_t i = 0; i < m_operators.size(); ++i)
+      m_operators[i]->apply(&image[first], last - first);
+  });
+}
+
+void PostProcess::encodeSRGB(const std::vector<Vector>& image, char* pixels) const
+{
+  forEachBlock(image.size(), THREADS, [&](size_t, size_t first, size_t last)
+  {
+    for(size_t i = first; i < last; ++i)
+    {
+      pixels[3*i]   = toSRGB8(image[i].x);
+      pixels[3*i+1] = toSRGB8(image[i].y);
+      pixels[3*i+2] = toSRGB8(image[i].z);
+    }
+  });
+}
@@ -1,5 +1,88 @@
 #include "rectangle.hpp"
+
+#include <algorithm>
+#include <cmath>
+
 #include "core.hpp"
+#include "aabb.hpp"
+
+namespace
+{
+  //Rectangles seen under a smaller solid angle are sampled by area, where the
+  //spherical construction loses its precision
+  const float MIN_SOLID_ANGLE = 0.0003f;
+  //Beyond this many diagonals from the rectangle it is sampled by area
+  const float FAR_DISTANCE = 4.0f;
+  const float PI = 3.14159265358979f;
+
+  //The rectangle in a frame centered at the reference point, with z pointing away from it
+  //(Urena et al., "An Area-Preserving Parametrization for Spherical Rectangles")
+  struct SphericalRectangle
+  {
+    Vector x, y, z;
+    float x0, y0, z0, x1, y1;
+    float b0, b1, k;
+    float solidAngle;
+
+    SphericalRectangle(const Vector& corner, const Vector& tangent, float sizeTangent, const Vector& bitangent, float sizeBitangent, const Vector& ref)
+    {
+      x = tangent;
+      y = bitangent;
+      z = x.cross(y);
+      Vector d = corner - ref;
+      z0 = d.dot(z);
+      if(z0 > 0.0f)
+      {
+        z0 = -z0;
+        z = -z;
+      }
+      x0 = d.dot(x);
+      y0 = d.dot(y);
+      x1 = x0 + sizeTangent;
+      y1 = y0 + sizeBitangent;
+
+      //Normals of the planes through ref and the four edges, and the angles between them.
+      //In this frame every normal has a zero component, so they are written out directly.
+      float z0Sq = z0 * z0;
+      float l0 = 1.0f / sqrtf(z0Sq + y0 * y0), l1 = 1.0f / sqrtf(z0Sq + x1 * x1);
+      float l2 = 1.0f / sqrtf(z0Sq + y1 * y1), l3 = 1.0f / sqrtf(z0Sq + x0 * x0);
+      float g0 = safeAcos(y0 * x1 * l0 * l1);
+      float g1 = safeAcos(-x1 * y1 * l1 * l2);
+      float g2 = safeAcos(y1 * x0 * l2 * l3);
+      float g3 = safeAcos(-x0 * y0 * l3 * l0);
+
+      b0 = -y0 * l0;
+      b1 = y1 * l2;
+      k = 2.0f * PI - g2 - g3;
+      solidAngle = g0 + g1 - k;
+    }
+
+    static float safeAcos(float c)
+    {
+      return std::acos(std::min(1.0f, std::max(-1.0f, c)));
+    }
+
+    //Offsets along x and y of the point u, v maps to
+    void sample(float u, float v, float& xu, float& yv) const
+    {
+      float au = u * solidAngle + k;
+      float sinAu = std::sin(au);
+      float fu = sinAu != 0.0f ? (std::cos(au) * b0 - b1) / sinAu : 0.0f;
+      //The paper's cu = sign(fu) / sqrt(fu^2 + b0^2), xu = -cu * z0 / sqrt(1 - cu^2) with one root less
+      float denominatorSq = fu * fu + b0 * b0 - 1.0f;
+      if(denominatorSq > 0.0f) xu = -z0 / std::copysign(sqrtf(denominatorSq), fu);
+      else xu = fu >= 0.0f ? x1 : x0;
+      xu = std::min(x1, std::max(x0, xu));
+
+      float ddSq = xu * xu + z0 * z0, dd = sqrtf(ddSq);
+      float h0 = y0 / sqrtf(ddSq + y0 * y0);
+      float h1 = y1 / sqrtf(ddSq + y1 * y1);
+      float hv = h0 + v * (h1 - h0), hvSq = hv * hv;
+      yv = hvSq < 1.0f - 1e-6f ? (hv * dd) / sqrtf(1.0f - hvSq) : y1;
+      yv = std::min(y1, std::max(y0, yv));
+    }
+  };
+}
 
 void Rectangle::setSizeTangent(float sizeTangent)
 {
@@ -29,12 +112,24 @@ float Rectangle::intersect(const Ray& ray) const
   return t;
 }
 
-Vector Rectangle::getNormalAt(const Vector&) const
+AABB Rectangle::getBoundingBox() const
+{
+  Vector t = m_tangent * m_sizeTangent;
+  Vector b = m_bitangent * m_sizeBitangent;
+  AABB box;
+  box.extend(point);
+  box.extend(point + t);
+  box.extend(point + b);
+  box.extend(point + t + b);
+  return box;
+}
+
+Vector Rectangle::getNormalAt(const Vector&, unsigned int) const
 {
   return m_normal;
 }
 
-void Rectangle::getUVAt(const Vector& point, float& u, float& v) const
+void Rectangle::getUVAt(const Vector& point, unsigned int, float& u, float& v) const
 {
   Vector relPoint = point - this->point;
   float distT = relPoint.dot(m_tangent);
@@ -43,24 +138,48 @@ void Rectangle::getUVAt(const Vector& point, float& u, float& v) const
   v = distB / m_sizeBitangent;
 }
 
-Vector Rectangle::getSample(RNG& rng) const
+SurfaceSample Rectangle::getSample(float u1, float u2) const
 {
-  return point + m_tangent*rng.get()*m_sizeTangent + m_bitangent*rng.get()*m_sizeBitangent;
+  return {point + m_tangent*u1*m_sizeTangent + m_bitangent*u2*m_sizeBitangent, 0};
 }
 
-void Rectangle::getSamples(RNG& rng, int s1, int s2, Vector* samples) const
+bool Rectangle::isSampledBySolidAngle(const Vector& ref) const
 {
-  float invS1 = 1.0f/s1;
-  float invS2 = 1.0f/s2;
-  float r1, r2;
-  int i = 0;
-  for(int ny = 0; ny < s2; ++ny)
+  //Parallelograms keep sampling by area
+  if(!(std::fabs(m_tangent.dot(m_bitangent)) < 0.0001f)) return false;
+
+  //Far away the area pdf hardly varies over the rectangle and the cheaper area sample is as good
+  Vector t = m_tangent * m_sizeTangent, b = m_bitangent * m_sizeBitangent;
+  Vector toCenter = point + (t + b) * 0.5f - ref;
+  return toCenter.lengthSq() < FAR_DISTANCE * FAR_DISTANCE * (t + b).lengthSq();
+}
+
+//Uniform over the solid angle the rectangle covers, seen from ref
+SurfaceSample Rectangle::getSampleFrom(const Vector& ref, float u1, float u2, float& pdf) const
+{
+  //Only the side the normal points to emits
+  if(!((ref - point).dot(m_normal) > 0.0f))
   {
-    for(int nx = 0; nx < s1; ++nx)
-    {
-      r1 = (nx + rng.get())*invS1;
-      r2 = (ny + rng.get())*invS2;
-      samples[i++] = point + m_tangent*r1*m_sizeTangent + m_bitangent*r2*m_sizeBitangent;
-    }
+    pdf = 0.0f;
+    return getSample(u1, u2);
   }
-}
\ No newline at end of file
+  if(!isSampledBySolidAngle(ref)) return Object::getSampleFrom(ref, u1, u2, pdf);
+
+  SphericalRectangle rect(point, m_tangent, m_sizeTangent, m_bitangent, m_sizeBitangent, ref);
+  if(!(rect.solidAngle > MIN_SOLID_ANGLE)) return Object::getSampleFrom(ref, u1, u2, pdf);
+
+  float xu, yv;
+  rect.sample(u1, u2, xu, yv);
+  pdf = 1.0f / rect.solidAngle;
+  return {ref + rect.x * xu + rect.y * yv + rect.z * rect.z0, 0};
+}
+
+float Rectangle::getPDFFrom(const Vector& ref, const Vector& point, unsigned int primitive) const
+{
+  if(!((ref - this->point).dot(m_normal) > 0.0f)) return 0.0f;
+  if(!isSampledBySolidAngle(ref)) return Object::getPDFFrom(ref, point, primitive);
+
+  SphericalRectangle rect(this->point, m_tangent, m_sizeTangent, m_bitangent, m_sizeBitangent, ref);
+  if(!(rect.solidAngle > MIN_SOLID_ANGLE)) return Object::getPDFFrom(ref, point, primitive);
+  return 1.0f / rect.solidAngle;
+}
@@ -0,0 +1,314 @@
+#include "renderJob.hpp"
+#include "film.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define PATHTRACER_POSIX
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utime.h>
+#endif
+
+namespace
+{
+  const char JOB_MAGIC[] = "PTJOB";
+  const char FILM_EXTENSION[] = ".film";
+
+  bool endsWith(const std::string& text, const std::string& suffix)
+  {
+    return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+  }
+
+  bool makeDirectory(const std::string& path)
+  {
+#ifdef PATHTRACER_POSIX
+    struct stat info;
+    if(stat(path.c_str(), &info) == 0) return S_ISDIR(info.st_mode);
+    return mkdir(path.c_str(), 0777) == 0;
+#else
+    (void)path;
+    return false;
+#endif
+  }
+}
+
+bool RenderJob::hasValidRegion() const
+{
+  return x0 < x1 && x1 <= width && y0 < y1 && y1 <= height;
+}
+
+bool RenderJob::hasValidSamples() const
+{
+  return firstSample < lastSample && lastSample <= samples;
+}
+
+bool RenderJob::isValid() const
+{
+  return hasValidRegion() && hasValidSamples();
+}
+
+std::vector<RenderJob> splitFrame(unsigned int width, unsigned int height, unsigned int samples, unsigned int tileSize, unsigned int samplesPerJob)
+{
+  tileSize = std::max(tileSize, 1u);
+  if(samplesPerJob == 0) samplesPerJob = samples;
+
+  std::vector<RenderJob> jobs;
+  for(unsigned int y = 0; y < height; y += tileSize)
+  {
+    for(unsigned int x = 0; x < width; x += tileSize)
+    {
+      for(unsigned int s = 0; s < samples; s += samplesPerJob)
+      {
+        RenderJob job;
+        job.width = width;
+        job.height = height;
+        job.samples = samples;
+        job.x0 = x;
+        job.y0 = y;
+        job.x1 = std::min(x + tileSize, width);
+        job.y1 = std::min(y + tileSize, height);
+        job.firstSample = s;
+        job.lastSample = std::min(s + samplesPerJob, samples);
+        jobs.push_back(job);
+      }
+    }
+  }
+  return jobs;
+}
+
+bool saveJob(const RenderJob& job, const char* fileName)
+{
+  std::ofstream file(fileName);
+  if(!file.is_open()) return false;
+  file << JOB_MAGIC << " " << job.width << " " << job.height << " " << job.samples << " "
+       << job.x0 << " " << job.y0 << " " << job.x1 << " " << job.y1 << " "
+       << job.firstSample << " " << job.lastSample << "\n";
+  file.close();
+  return (bool)file;
+}
+
+bool loadJob(const char* fileName, RenderJob& job)
+{
+  std::ifstream file(fileName);
+  std::string magic;
+  if(!(file >> magic) || magic != JOB_MAGIC) return false;
+  file >> job.width >> job.height >> job.samples >> job.x0 >> job.y0 >> job.x1 >> job.y1 >> job.firstSample >> job.lastSample;
+  return file && job.isValid();
+}
+
+bool mergePartials(const std::vector<std::string>& fileNames, Film& film)
+{
+  Film part;
+  for(size_t i = 0; i < fileNames.size(); ++i)
+  {
+    if(!part.load(fileNames[i].c_str()))
+    {
+      std::cout << "ERROR: Partial film (" << fileNames[i] << ") could not be loaded!\n";
+      return false;
+    }
+    if(i == 0)
+      film.reset(part.getImageWidth(), part.getImageHeight(), part.getSeed());
+    if(!film.merge(part))
+    {
+      std::cout << "ERROR: Partial film (" << fileNames[i] << ") belongs to another image!\n";
+      return false;
+    }
+  }
+  return !fileNames.empty();
+}
+
+JobQueue::JobQueue(const std::string& directory): m_directory(directory), CLAIM_TIMEOUT(60.0f)
+{
+#ifdef PATHTRACER_POSIX
+  m_workerName = getWorkerName(getpid());
+#endif
+}
+
+std::string JobQueue::getWorkerName(long processId)
+{
+  char host[256] = "localhost";
+#ifdef PATHTRACER_POSIX
+  if(gethostname(host, sizeof(host) - 1) != 0) std::snprintf(host, sizeof(host), "localhost");
+  host[sizeof(host) - 1] = '\0';
+#endif
+  return std::string(host) + "-" + std::to_string(processId);
+}
+
+std::vector<std::string> JobQueue::list(const std::string& subdirectory) const
+{
+  std::vector<std::string> names;
+#ifdef PATHTRACER_POSIX
+  DIR* directory = opendir((m_directory + "/" + subdirectory).c_str());
+  if(!directory) return names;
+  while(struct dirent* entry = readdir(directory))
+  {
+    if(entry->d_name[0] != '.') names.push_back(entry->d_name);
+  }
+  closedir(directory);
+  //Jobs are taken in the order they were created
+  std::sort(names.begin(), names.end());
+#endif
+  return names;
+}
+
+bool JobQueue::create(const std::vector<RenderJob>& jobs)
+{
+#ifndef PATHTRACER_POSIX
+  std::cout << "ERROR: Job directories are only supported on POSIX systems!\n";
+  return false;
+#endif
+  if(!makeDirectory(m_directory) || !makeDirectory(m_directory + "/pending") ||
+     !makeDirectory(m_directory + "/running") || !makeDirectory(m_directory + "/done") ||
+     !makeDirectory(m_directory + "/failed"))
+  {
+    std::cout << "ERROR: Job directory (" << m_directory << ") could not be created!\n";
+    return false;
+  }
+  if(!list("pending").empty() || !list("running").empty() || !list("done").empty() || !list("failed").empty())
+  {
+    std::cout << "ERROR: Job directory (" << m_directory << ") already holds a frame!\n";
+    return false;
+  }
+
+  for(size_t i = 0; i < jobs.size(); ++i)
+  {
+    char name[32];
+    std::snprintf(name, sizeof(name), "/%06zu.job", i);
+    //Written under another name first, workers must never see a half-written job
+    std::string path = m_directory + "/pending" + name;
+    if(!saveJob(jobs[i], (path + ".tmp").c_str()) || std::rename((path + ".tmp").c_str(), path.c_str()) != 0)
+    {
+      std::cout << "ERROR: Job (" << path << ") could not be saved!\n";
+      return false;
+    }
+  }
+
+  std::ofstream frame(m_directory + "/frame");
+  frame << jobs.size() << "\n";
+  frame.close();
+  return (bool)frame;
+}
+
+bool JobQueue::claim(RenderJob& job, std::string& partialFile)
+{
+  std::vector<std::string> pending = list("pending");
+  for(size_t i = 0; i < pending.size(); ++i)
+  {
+    const std::string& name = pending[i];
+    if(!endsWith(name, ".job")) continue;
+    //Another worker may have renamed the job since it was listed
+    std::string claimed = m_directory + "/running/" + name + "." + m_workerName;
+    if(std::rename((m_directory + "/pending/" + name).c_str(), claimed.c_str()) != 0) continue;
+
+    //Jobs which cannot be read are set aside, nobody would ever complete them
+    if(!loadJob(claimed.c_str(), job))
+    {
+      std::cout << "ERROR: Job (" << claimed << ") could not be loaded!\n";
+      std::rename(claimed.c_str(), (m_directory + "/failed/" + name).c_str());
+      continue;
+    }
+    partialFile = m_directory + "/done/" + name.substr(0, name.size() - 4) + FILM_EXTENSION;
+    return true;
+  }
+  return false;
+}
+
+std::string JobQueue::getClaimPath(const std::string& partialFile) const
+{
+  size_t start = partialFile.rfind('/') + 1;
+  std::string name = partialFile.substr(start, partialFile.size() - start - (sizeof(FILM_EXTENSION) - 1));
+  return m_directory + "/running/" + name + ".job." + m_workerName;
+}
+
+void JobQueue::complete(const std::string& partialFile)
+{
+  std::remove(getClaimPath(partialFile).c_str());
+}
+
+void JobQueue::keepAlive(const std::string& partialFile)
+{
+#ifdef PATHTRACER_POSIX
+  utime(getClaimPath(partialFile).c_str(), nullptr);
+#else
+  (void)partialFile;
+#endif
+}
+
+size_t JobQueue::release(const std::string& workerName)
+{
+  std::string suffix = "." + workerName;
+  std::vector<std::string> running = list("running");
+  size_t released = 0;
+  for(size_t i = 0; i < running.size(); ++i)
+  {
+    const std::string& name = running[i];
+    if(!endsWith(name, suffix)) continue;
+    std::string job = name.substr(0, name.size() - suffix.size());
+    if(std::rename((m_directory + "/running/" + name).c_str(), (m_directory + "/pending/" + job).c_str()) == 0)
+      ++released;
+  }
+  return released;
+}
+
+size_t JobQueue::releaseStale()
+{
+  std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+  std::vector<std::string> running = list("running");
+  std::map<std::string, ClaimState> claims;
+  size_t released = 0;
+  for(size_t i = 0; i < running.size(); ++i)
+  {
+    const std::string& name = running[i];
+    std::string path = m_directory + "/running/" + name;
+    time_t modified = 0;
+#ifdef PATHTRACER_POSIX
+    struct stat info;
+    if(stat(path.c_str(), &info) != 0) continue;
+    modified = info.st_mtime;
+#endif
+
+    ClaimState state = {modified, now};
+    std::map<std::string, ClaimState>::const_iterator it = m_claims.find(name);
+    if(it != m_claims.end() && it->second.modified == modified)
+      state.seen = it->second.seen;
+
+    std::chrono::duration<float> age = now - state.seen;
+    if(age.count() < CLAIM_TIMEOUT)
+    {
+      claims[name] = state;
+      continue;
+    }
+    //The worker name follows the job name (NNNNNN.job)
+    size_t end = name.find(".job.");
+    if(end != std::string::npos && std::rename(path.c_str(), (m_directory + "/pending/" + name.substr(0, end + 4)).c_str()) == 0)
+      ++released;
+  }
+  m_claims.swap(claims);
+  return released;
+}
+
+size_t JobQueue::getJobCount() const
+{
+  std::ifstream frame(m_directory + "/frame");
+  size_t count = 0;
+  frame >> count;
+  return count;
+}
+
+std::vector<std::string> JobQueue::getPartials() const
+{
+  std::vector<std::string> names = list("done"), partials;
+  for(size_t i = 0; i < names.size(); ++i)
+  {
+    //Films being saved have a temporary name until they are complete
+    if(endsWith(names[i], FILM_EXTENSION))
+      partials.push_back(m_directory + "/done/" + names[i]);
+  }
+  return partials;
+}
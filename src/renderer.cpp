@@ -7,127 +7,465 @@
 #include "utils.hpp"
 #include "light.hpp"
 #include "brdf.hpp"
+#include "tileScheduler.hpp"
+#include "scratchArena.hpp"
+#include "allocationCounter.hpp"
+#include "film.hpp"
+#include "sampler.hpp"
+#include "lightTree.hpp"
+#include "environmentMap.hpp"
+#include "postProcess.hpp"
+#include "imageFile.hpp"
+#include "renderJob.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <numeric>
+#include <thread>
+
+namespace
+{
+  //Weight of a sample taken with density pdf, when the other strategy would have
+  //produced it with density otherPDF
+  float powerHeuristic(float pdf, float otherPDF)
+  {
+    float a = pdf * pdf, b = otherPDF * otherPDF;
+    return a + b > 0.0f ? a / (a + b) : 0.0f;
+  }
+
+  //From world space to the frame of BRDF::sample_f, in which the normal points along y
+  Vector toShadingFrame(const Vector& v, const Vector& normal, const Vector& tangent, const Vector& bitangent)
+  {
+    return Vector(v.dot(tangent), v.dot(normal), v.dot(bitangent));
+  }
+
+  //Width in texture coordinates of a footprint of the given width around point, measured
+  //by looking up the coordinates one footprint away along the surface
+  float textureFootprint(const Object& object, const Vector& point, unsigned int primitive, const Vector& tangent, const Vector& bitangent, float u, float v, float width)
+  {
+    float ut, vt, ub, vb;
+    object.getUVAt(point + tangent * width, primitive, ut, vt);
+    object.getUVAt(point + bitangent * width, primitive, ub, vb);
+    //Coordinates wrap around, a seam between the points does not make the footprint large
+    auto delta = [](float a, float b) { float d = a - b; return d - std::round(d); };
+    float du = delta(ut, u), dv = delta(vt, v);
+    float dt = du * du + dv * dv;
+    du = delta(ub, u);
+    dv = delta(vb, v);
+    return sqrtf(std::max(dt, du * du + dv * dv));
+  }
+}
+
+//Samples spread over a pixel already average the texture over it, so the footprint
+//textures are prefiltered over shrinks with the sample count (as in pbrt-v4)
+float Renderer::getTextureSpread(const Camera& camera, unsigned int samples) const
+{
+  return camera.getPixelSpread(m_height) * std::max(0.125f, 1.0f / sqrtf(std::max(samples, 1u)));
+}
 
 void Renderer::render(const Scene& scene, const Camera& camera, char* &pixels)
 {
-  if(pixels) delete[] pixels;
+  Film film;
+  render(scene, camera, film);
+  tonemap(film, pixels);
+}
 
-  int len = 3*m_width*m_height;
-  pixels = new char[len];
-  Vector* data = new Vector[m_width*m_height];
+void Renderer::render(const Scene& scene, const Camera& camera, Film& film)
+{
+  film.reset(m_width, m_height, SEED);
+  m_pixelSpread = getTextureSpread(camera, MC_SAMPLES);
+  LightTree lightTree;
+  buildLightTree(scene, lightTree);
+  renderPass(scene, lightTree, camera, film, MC_SAMPLES, nullptr);
+}
 
-  std::vector<std::shared_ptr<Object>> objects = scene.getObjects();
-  std::vector<std::shared_ptr<Object>> areaLights;
+bool Renderer::renderStreaming(const Scene& scene, const Camera& camera, const char* fileName, const char* hdrFileName)
+{
+  PostProcess post;
+  post.THREADS = THREADS;
+  post.addOperator(std::make_shared<ReinhardOperator>());
 
-  for(size_t i = 0; i < objects.size(); ++i)
+  //Tone mapping needs statistics of the whole image before the first band is written
   {
-    if(objects[i]->material->isEmissive() && objects[i]->isFinite())
-      areaLights.push_back(objects[i]);
+    float scale = std::max(1.0f, sqrtf((float)m_width * m_height / std::max(PREVIEW_PIXELS, 1u)));
+    Renderer preview(*this);
+    preview.reset(std::max(1u, (unsigned int)(m_width / scale)), std::max(1u, (unsigned int)(m_height / scale)));
+    preview.MC_SAMPLES = PREVIEW_SAMPLES > 0 ? PREVIEW_SAMPLES : MC_SAMPLES;
+    std::cout << "Preview (" << preview.getWidth() << "x" << preview.getHeight() << ")\n";
+    Film film;
+    preview.render(scene, camera, film);
+    std::vector<Vector> image;
+    post.resolve(film, image);
+    post.prepare(std::move(image));
   }
 
-  Vector color;
-  int i;
-  float samples_factor = 1.0f/MC_SAMPLES;
-  int s1 = std::sqrt(LIGHT_SAMPLES);
-  int s2 = LIGHT_SAMPLES/s1;
-  //Tone mapping
-  Vector xyz;
-  float Lavg = 0, a = 0.18;
-  for(unsigned int y = 0; y < m_height; ++y)
+  PPMWriter output;
+  PFMWriter hdrOutput;
+  if(!output.open(fileName, m_width, m_height))
   {
-    for(unsigned int x = 0; x < m_width; ++x)
+    std::cout << "ERROR: Image (" << fileName << ") could not be saved!\n";
+    return false;
+  }
+  if(hdrFileName && !hdrOutput.open(hdrFileName, m_width, m_height))
+  {
+    std::cout << "ERROR: HDR image (" << hdrFileName << ") could not be saved!\n";
+    return false;
+  }
+
+  m_pixelSpread = getTextureSpread(camera, MC_SAMPLES);
+  LightTree lightTree;
+  buildLightTree(scene, lightTree);
+  unsigned int bandHeight = std::max(BAND_HEIGHT, 1u);
+  unsigned int bands = (m_height + bandHeight - 1) / bandHeight;
+  Film film;
+  std::vector<Vector> image;
+  std::vector<char> pixels;
+  bool written = true, hdrWritten = true;
+  for(unsigned int band = 0; band < bands; ++band)
+  {
+    unsigned int firstRow = band * bandHeight;
+    unsigned int rows = std::min(bandHeight, m_height - firstRow);
+    std::cout << "Band " << band + 1 << " of " << bands << "\n";
+    film.reset(m_width, rows, SEED);
+    film.setRegion(0, firstRow, m_width, m_height);
+    renderPass(scene, lightTree, camera, film, MC_SAMPLES, nullptr);
+
+    post.resolve(film, image);
+    for(unsigned int y = 0; hdrFileName && y < rows; ++y)
+      hdrWritten = hdrWritten && hdrOutput.writeRow(firstRow + y, &image[(size_t)y * m_width]);
+    post.applyPrepared(image);
+    pixels.resize(3 * image.size());
+    post.encodeSRGB(image, pixels.data());
+    written = written && output.writeRows(firstRow, rows, pixels.data());
+  }
+
+  if(!output.close() || !written)
+  {
+    std::cout << "ERROR: Image (" << fileName << ") could not be saved!\n";
+    return false;
+  }
+  if(hdrFileName && (!hdrOutput.close() || !hdrWritten))
+  {
+    std::cout << "ERROR: HDR image (" << hdrFileName << ") could not be saved!\n";
+    return false;
+  }
+  return true;
+}
+
+bool Renderer::renderJob(const Scene& scene, const Camera& camera, const RenderJob& job, Film& film)
+{
+  if(job.width != m_width || job.height != m_height)
+  {
+    std::cout << "ERROR: Job of a " << job.width << "x" << job.height << " image does not fit a "
+              << m_width << "x" << m_height << " image!\n";
+    return false;
+  }
+  if(!job.hasValidRegion())
+  {
+    std::cout << "ERROR: Job pixels (" << job.x0 << "," << job.y0 << " to " << job.x1 << "," << job.y1
+              << ") are not a rectangle within the image!\n";
+    return false;
+  }
+  if(!job.hasValidSamples())
+  {
+    std::cout << "ERROR: Job samples (" << job.firstSample << " to " << job.lastSample
+              << ") are not a range within the " << job.samples << " samples per pixel!\n";
+    return false;
+  }
+
+  film.reset(job.x1 - job.x0, job.y1 - job.y0, SEED);
+  film.setRegion(job.x0, job.y0, m_width, m_height);
+  film.setFirstSample(job.firstSample);
+  //Textures are filtered for the samples of the whole frame, as in a single render
+  m_pixelSpread = getTextureSpread(camera, job.samples);
+  LightTree lightTree;
+  buildLightTree(scene, lightTree);
+  renderPass(scene, lightTree, camera, film, job.lastSample - job.firstSample, nullptr);
+  return true;
+}
+
+bool Renderer::renderProgressive(const Scene& scene, const Camera& camera, Film& film, unsigned int samples, const char* checkpointFile)
+{
+  if(film.getWidth() != m_width || film.getHeight() != m_height)
+  {
+    std::cout << "ERROR: Film size (" << film.getWidth() << "x" << film.getHeight() << ") does not match the renderer!\n";
+    return false;
+  }
+  //Samples of a resumed pixel are numbered from its count on, parts of other images would
+  //repeat samples rendered elsewhere
+  if(film.getImageWidth() != m_width || film.getImageHeight() != m_height || film.getFirstSample() != 0)
+  {
+    std::cout << "ERROR: Film is part of a distributed render and cannot be resumed!\n";
+    return false;
+  }
+
+  m_pixelSpread = getTextureSpread(camera, samples);
+  LightTree lightTree;
+  buildLightTree(scene, lightTree);
+  auto start = std::chrono::steady_clock::now();
+  auto lastCheckpoint = start;
+  std::vector<unsigned int> plan(m_width * m_height);
+  for(;;)
+  {
+    size_t active = planPass(film, samples, plan);
+    if(active == 0) break;
+
+    std::chrono::duration<float> elapsed = std::chrono::steady_clock::now() - start;
+    if(TIME_BUDGET > 0.0f && elapsed.count() >= TIME_BUDGET)
     {
-      color = Vector(0,0,0);
-      for(unsigned int n = 0; n < MC_SAMPLES; ++n)
-        color += sample(x, y, scene, areaLights, camera, s1, s2);
-      color *= samples_factor;
+      std::cout << "Time budget reached\n";
+      break;
+    }
+    unsigned long long planned = std::accumulate(plan.begin(), plan.end(), 0ull);
+    if(SAMPLE_BUDGET > 0 && film.getTotalSampleCount() + planned > SAMPLE_BUDGET)
+    {
+      std::cout << "Sample budget reached\n";
+      break;
+    }
 
-      xyz = toXYZ(color);
-      float Y = xyz.y;
-      float factor = 1.0f / (xyz.x + xyz.y + xyz.z);
-      Lavg += std::log(Y + 0.000001);
+    std::cout << "Pass " << film.getPasses() + 1 << ": " << 100.0 * active / plan.size() << "% of pixels, "
+              << (float)film.getTotalSampleCount() / plan.size() << " samples per pixel on average\n";
+    renderPass(scene, lightTree, camera, film, samples, plan.data());
 
-      xyz *= factor;
-      xyz.z = Y;
+    elapsed = std::chrono::steady_clock::now() - lastCheckpoint;
+    if(checkpointFile && elapsed.count() >= CHECKPOINT_INTERVAL)
+    {
+      if(!film.save(checkpointFile))
+        std::cout << "ERROR: Checkpoint (" << checkpointFile << ") could not be saved!\n";
+      lastCheckpoint = std::chrono::steady_clock::now();
+    }
+  }
 
-      i = y * m_width + x;
-      data[i] = xyz;
+  if(checkpointFile && !film.save(checkpointFile))
+    std::cout << "ERROR: Checkpoint (" << checkpointFile << ") could not be saved!\n";
+  return true;
+}
+
+size_t Renderer::planPass(const Film& film, unsigned int samples, std::vector<unsigned int>& plan) const
+{
+  unsigned int passSamples = std::max(PASS_SAMPLES, 1u);
+  bool adaptive = ADAPTIVE_THRESHOLD > 0.0f;
 
-      if(i % 500 == 0) std::cout << 300.0 * i / len << "%\n";
+  //A pixel keeps sampling while its own error or the error of any neighbour is above
+  //the threshold, single pixels estimates are too noisy to stop on
+  std::vector<float> error;
+  if(adaptive)
+  {
+    error.resize(m_width * m_height);
+    for(unsigned int y = 0; y < m_height; ++y)
+    {
+      for(unsigned int x = 0; x < m_width; ++x)
+        error[y * m_width + x] = film.getError(x, y);
     }
   }
 
-  Lavg = std::exp(3.0*Lavg/len);
-  float L, Lfactor = a/Lavg;
+  size_t active = 0;
   for(unsigned int y = 0; y < m_height; ++y)
   {
     for(unsigned int x = 0; x < m_width; ++x)
     {
-      i = y * m_width + x;
-      L = data[i].z * Lfactor;
-      L = L / (1.0f + L);
+      unsigned int count = film.getSampleCount(x, y);
+      unsigned int n = count < samples ? std::min(passSamples, samples - count) : 0;
+      if(n > 0 && adaptive && count >= MIN_SAMPLES)
+      {
+        float maxError = 0.0f;
+        for(unsigned int ny = (y > 0 ? y - 1 : 0); ny <= std::min(y + 1, m_height - 1); ++ny)
+        {
+          for(unsigned int nx = (x > 0 ? x - 1 : 0); nx <= std::min(x + 1, m_width - 1); ++nx)
+            maxError = std::max(maxError, error[ny * m_width + nx]);
+        }
+        if(maxError <= ADAPTIVE_THRESHOLD) n = 0;
+      }
 
-      const float X = L/data[i].y * data[i].x;
-      const float Y = L;
-      const float Z = L/data[i].y * (1.0f - data[i].x - data[i].y);
+      plan[y * m_width + x] = n;
+      if(n > 0) ++active;
+    }
+  }
+  return active;
+}
 
-      color = fromXYZ({X, Y, Z});
+void Renderer::buildLightTree(const Scene& scene, LightTree& lightTree)
+{
+  const std::vector<std::shared_ptr<Object>>& objects = scene.getObjects();
+  std::vector<const Object*> areaLights;
 
-      sRGBEncode(color);
-      //+0.5 -- better approx. (lower quantization error)
-      pixels[3*i]   =   (unsigned char)(std::min(255.0f, std::max(0.0f, 255*color.x)) + 0.5f);
-      pixels[3*i+1] =   (unsigned char)(std::min(255.0f, std::max(0.0f, 255*color.y)) + 0.5f);
-      pixels[3*i+2] =   (unsigned char)(std::min(255.0f, std::max(0.0f, 255*color.z)) + 0.5f);
+  for(size_t i = 0; i < objects.size(); ++i)
+  {
+    if(objects[i]->material && objects[i]->material->isEmissive() && objects[i]->isFinite())
+      areaLights.push_back(objects[i].get());
+  }
+  lightTree.build(areaLights);
+}
+
+void Renderer::renderPass(const Scene& scene, const LightTree& lightTree, const Camera& camera, Film& film, unsigned int samples, const unsigned int* plan)
+{
+  unsigned int threads = THREADS > 0 ? THREADS : TileScheduler::getDefaultThreadCount();
+  TileScheduler scheduler(film.getWidth(), film.getHeight(), TILE_SIZE, threads);
+  std::atomic<size_t> tilesDone(0);
+  std::mutex outputMutex;
+
+  //Every worker gets its own sampler and scratch memory sized for one path's light samples
+  std::vector<ScratchArena> arenas;
+  std::vector<std::unique_ptr<Sampler>> samplers;
+  size_t scratchSize = std::max<size_t>(4096, 2 * LIGHT_SAMPLES * sizeof(float));
+  for(unsigned int t = 0; t < threads; ++t)
+  {
+    arenas.emplace_back(scratchSize);
+    samplers.push_back(Sampler::create(SAMPLER, film.getSeed()));
+  }
+  std::atomic<size_t> allocations(0);
+
+  auto worker = [&](unsigned int index)
+  {
+    Tile tile;
+    while(scheduler.next(index, tile))
+    {
+      size_t allocationsBefore = getThreadAllocationCount();
+      renderTile(tile, scene, lightTree, camera, *samplers[index], arenas[index], film, samples, plan);
+      allocations += getThreadAllocationCount() - allocationsBefore;
+
+      size_t done = ++tilesDone;
+      std::lock_guard<std::mutex> lock(outputMutex);
+      std::cout << 100.0 * done / scheduler.getTileCount() << "%\n";
+    }
+  };
+
+  std::vector<std::thread> pool;
+  for(unsigned int t = 1; t < threads; ++t)
+    pool.emplace_back(worker, t);
+  worker(0);
+  for(size_t t = 0; t < pool.size(); ++t)
+    pool[t].join();
+
+  film.completePass();
+
+  if(isAllocationCountingEnabled())
+    std::cout << "Heap allocations while tracing: " << allocations << "\n";
+}
+
+void Renderer::tonemap(const Film& film, char* &pixels)
+{
+  if(pixels) delete[] pixels;
+
+  PostProcess post;
+  post.THREADS = THREADS;
+  post.addOperator(std::make_shared<ReinhardOperator>());
+  std::vector<Vector> image;
+  post.resolve(film, image);
+  post.apply(image);
+
+  pixels = new char[3 * image.size()];
+  post.encodeSRGB(image, pixels);
+}
+
+void Renderer::renderTile(const Tile& tile, const Scene& scene, const LightTree& lightTree, const Camera& camera, Sampler& sampler, ScratchArena& arena, Film& film, unsigned int samples, const unsigned int* plan)
+{
+  Vector color, halfColor, c;
+  int s1 = std::sqrt(LIGHT_SAMPLES);
+  int s2 = s1 > 0 ? LIGHT_SAMPLES/s1 : 0;
+  unsigned int left = film.getLeft(), top = film.getTop();
+  for(unsigned int y = tile.y0; y < tile.y1; ++y)
+  {
+    for(unsigned int x = tile.x0; x < tile.x1; ++x)
+    {
+      unsigned int pixelSamples = plan ? plan[y * film.getWidth() + x] : samples;
+      if(pixelSamples == 0) continue;
+
+      unsigned int first = film.getFirstSample() + film.getSampleCount(x, y);
+      color = halfColor = Vector(0,0,0);
+      for(unsigned int n = 0; n < pixelSamples; ++n)
+      {
+        sampler.startSample(left + x, top + y, first + n);
+        c = sample(left + x, top + y, scene, lightTree, camera, sampler, arena, s1, s2);
+        color += c;
+        if((first + n) % 2 == 1) halfColor += c;
+      }
+
+      film.addSamples(x, y, color, halfColor, pixelSamples);
     }
   }
 }
 
-Vector Renderer::sample(float x, float y, const Scene& scene, const std::vector<std::shared_ptr<Object>>& emissiveObjects, const Camera& camera, unsigned int s1, unsigned int s2)
+Vector Renderer::sample(float x, float y, const Scene& scene, const LightTree& lightTree, const Camera& camera, Sampler& sampler, ScratchArena& arena, unsigned int s1, unsigned int s2)
 {
   //[0, w] /w => [0, 1] *2 - 1 => [-1, 1]
   //            this + 0.5 is because we want to hit the middle of the pixel
-  //x + jitterX = (x + 0.5) + (m_rng.get() - 0.5f) = x + m_rng.get()
-  float rx = (2.0f*((x + m_rng.get()) / m_width) - 1.0f)*m_ar;
-  float ry = 1.0f - 2.0f*((y + m_rng.get()) / m_height);
+  //x + jitterX = (x + 0.5) + (jitter - 0.5f) = x + jitter
+  float jitterX, jitterY;
+  sampler.get2D(jitterX, jitterY);
+  float rx = (2.0f*((x + jitterX) / m_width) - 1.0f)*m_ar;
+  float ry = 1.0f - 2.0f*((y + jitterY) / m_height);
 
   Ray ray = camera.getCameraRay(rx, ry);
 
-  return traceRay(ray, scene, emissiveObjects, m_rng, s1, s2);
+  return traceRay(ray, scene, lightTree, sampler, arena, s1, s2, m_pixelSpread);
 }
 
-Vector Renderer::traceRay(Ray &ray, const Scene &scene, const std::vector<std::shared_ptr<Object>> &areaLights, RNG &rng, unsigned int s1, unsigned int s2)
+Vector Renderer::traceRay(Ray &ray, const Scene &scene, const LightTree& lightTree, Sampler& sampler, ScratchArena& arena, unsigned int s1, unsigned int s2, float spread)
 {
   Vector color;
   Vector intersectionPoint;
   Vector beta(1, 1, 1);
-  std::shared_ptr<Object> object = nullptr;
+  const Object* object = nullptr;
+  //The vertex the current ray left from
+  const Object* previousObject = nullptr;
+  Vector previousPoint, previousNormal;
 
   int nRealSamples = s1*s2;
-  Vector *lightSamples = new Vector[nRealSamples];
-
-  std::vector<std::shared_ptr<Light>> lights = scene.getLights();
+  arena.reset();
+  float *lightSamples = arena.allocate<float>(2 * nRealSamples);
+
+  const std::vector<std::shared_ptr<Light>>& lights = scene.getLights();
+  const EnvironmentMap& envMap = scene.getEnvironmentMap();
+  bool sampleEnvironment = envMap.isSamplable();
+  bool sampleLights = nRealSamples > 0 && !lightTree.isEmpty();
+  //Density of the BRDF sample which produced the current ray, 0 for the camera ray
+  float brdfPDF = 0.0f;
+  //Width of the footprint of a pixel at the current vertex, for texture filtering
+  float coneWidth = 0.0f;
 
   for (int bounces = 0;;++bounces)
   {
     float closestT;
-    object = scene.intersect(ray, &closestT);
+    unsigned int primitive;
+    object = scene.intersect(ray, &closestT, &primitive);
 
     if(!object) 
     {
-      color += beta*scene.getEnvironmentMap().sample(ray.direction);
+      //The environment is also sampled directly at every vertex, the two estimates are combined
+      Vector radiance = envMap.sample(ray.direction);
+      if(sampleEnvironment && brdfPDF > 0.0f)
+        radiance *= powerHeuristic(brdfPDF, envMap.getPDF(ray.direction));
+      color += beta*radiance;
       break;
     }
 
     intersectionPoint = ray(closestT);                      
-    Vector normal = object->getNormalAt(intersectionPoint);
+    Vector normal = object->getNormalAt(intersectionPoint, primitive);
     float u, v;
-    object->getUVAt(intersectionPoint, u, v);
+    object->getUVAt(intersectionPoint, primitive, u, v);
 
-    Vector albedo = object->material->getColor(u, v);
-    BRDF* brdf = object->material->getBRDF();
+    Vector tangent, bitangent;
+    createOrthogonalSystem(normal, tangent, bitangent);
+
+    //The ray cone widens by spread per unit of distance along the whole path
+    coneWidth += spread * closestT;
+    float footprint = coneWidth > 0.0f ? textureFootprint(*object, intersectionPoint, primitive, tangent, bitangent, u, v, coneWidth) : 0.0f;
+    const BaseMaterial* material = object->getMaterial(primitive);
+    Vector albedo = material->getColor(u, v, footprint);
+    BRDF* brdf = material->getBRDF();
 
     Vector wo = -ray.direction, wi;
 
+    //Every bounce takes the same dimensions in the same order, whatever is hit
+    float brdfU1, brdfU2;
+    sampler.get2D(brdfU1, brdfU2);
+    float roulette = sampler.get1D();
+    float envU1, envU2;
+    if(sampleEnvironment) sampler.get2D(envU1, envU2);
+
     //Direct illumination
     LightingInformation li;
     for(size_t i = 0; i < lights.size(); ++i)
@@ -141,52 +479,81 @@ Vector Renderer::traceRay(Ray &ray, const Scene &scene, const std::vector<std::s
       }
     }
 
-    //Area lights
-    if(s1 > 0 && s2 > 0)
+    //Area lights, every sample picks one light in proportion to its estimated contribution.
+    //Each one is weighted against finding the same point by BRDF sampling.
+    if(sampleLights)
     {
-      Vector samplePoint;
+      Vector woLocal = toShadingFrame(wo, normal, tangent, bitangent);
+      sampler.get2DArray(nRealSamples, lightSamples);
       Vector col;
-      Vector normalAtSample;
-      std::shared_ptr<Object> aLight;
-      Ray shadowRay;
-      for(size_t i = 0; i < areaLights.size(); ++i)
+      for(int n = 0; n < nRealSamples; ++n)
       {
-        aLight = areaLights[i];
-        if(object == aLight) continue;
-        aLight->getSamples(rng, s1, s2, lightSamples);
-        for(int n = 0; n < nRealSamples; ++n)
+        float u1 = lightSamples[2*n], lightPMF;
+        const Object* aLight = lightTree.sample(intersectionPoint, normal, u1, lightPMF);
+        if(!aLight || aLight == object) continue;
+
+        float samplePDF;
+        SurfaceSample lightSample = aLight->getSampleFrom(intersectionPoint, u1, lightSamples[2*n + 1], samplePDF);
+        if(samplePDF <= 0.0f) continue;
+        wi = lightSample.point - intersectionPoint;
+        float limitT = wi.length();
+        wi /= limitT;
+        Vector normalAtSample = aLight->getNormalAt(lightSample.point, lightSample.primitive);
+        float cosLight = (-wi).dot(normalAtSample);
+        float cosPoint = wi.dot(normal);
+        if(cosLight <= 0.0f || cosPoint <= 0.0f) continue;
+
+        Ray shadowRay(intersectionPoint + wi * 0.0001f, wi);
+        if(!scene.occlusionTest(shadowRay, limitT * 0.999f))
         {
-          samplePoint = lightSamples[n];
-          wi = samplePoint - intersectionPoint;
-          float lenSq = wi.lengthSq();
-          float limitT = sqrtf(lenSq);
-          wi /= limitT;
-          shadowRay = Ray(intersectionPoint + wi * 0.0001f, wi);
-          if(!scene.occlusionTest(shadowRay, limitT * 0.999f))
-          {
-            normalAtSample = aLight->getNormalAt(samplePoint);
-            float cosLight = saturate((-wi).dot(normalAtSample));
-            float cosPoint = saturate(wi.dot(normal));
-            float uLight, vLight;
-            aLight->getUVAt(samplePoint, uLight, vLight);
-            col += (1.0f/lenSq) * cosPoint * cosLight * brdf->f(wo, wi) * aLight->material->getEmittance(uLight, vLight);
-          }
+          //Density per solid angle of picking this light and this point on it
+          float lightPDF = lightPMF * samplePDF;
+          float weight = powerHeuristic(nRealSamples * lightPDF, brdf->pdf(woLocal, toShadingFrame(wi, normal, tangent, bitangent)));
+          float uLight, vLight;
+          aLight->getUVAt(lightSample.point, lightSample.primitive, uLight, vLight);
+          col += (cosPoint * weight / lightPDF) * brdf->f(wo, wi) * aLight->material->getEmittance(uLight, vLight);
         }
-        color += beta*albedo*col/(nRealSamples*aLight->getInversePDF());
       }
+      color += beta*albedo*col/nRealSamples;
     }
 
-    color += beta*object->material->getEmittance(u, v);
+    //Environment
+    if(sampleEnvironment)
+    {
+      float envPDF;
+      wi = envMap.sampleDirection(envU1, envU2, envPDF);
+      float cosPoint = wi.dot(normal);
+      if(envPDF > 0.0f && cosPoint > 0.0f && !scene.occlusionTest(Ray(intersectionPoint + wi * 0.0001f, wi), -1.0f))
+      {
+        float samplePDF = brdf->pdf(toShadingFrame(wo, normal, tangent, bitangent), toShadingFrame(wi, normal, tangent, bitangent));
+        float weight = powerHeuristic(envPDF, samplePDF);
+        color += beta*albedo*envMap.sample(wi)*brdf->f(wo, wi)*(cosPoint*weight/envPDF);
+      }
+    }
+
+    //Emission found by BRDF sampling counts only as much as light sampling would not have found it
+    if(material->isEmissive())
+    {
+      Vector emittance = material->getEmittance(u, v);
+      if(brdfPDF > 0.0f && sampleLights && object != previousObject)
+      {
+        float lightPDF = lightTree.getPMF(previousPoint, previousNormal, object) * object->getPDFFrom(previousPoint, intersectionPoint, primitive);
+        emittance *= powerHeuristic(brdfPDF, nRealSamples * lightPDF);
+      }
+      color += beta*emittance;
+    }
     
     //Indirect Illumination
     float pdf;
     Vector sample;
-    float f = brdf->sample_f(wo, sample, rng, pdf);
-    Vector tangent, bitangent;
+    float f = brdf->sample_f(wo, sample, brdfU1, brdfU2, pdf);
 
     if(f < 0.0001 || pdf == 0) break;
+    brdfPDF = pdf;
+    previousObject = object;
+    previousPoint = intersectionPoint;
+    previousNormal = normal;
 
-    createOrthogonalSystem(normal, tangent, bitangent);
     wi = Vector(
       sample.x * tangent.x + sample.y * normal.x + sample.z * bitangent.x,
       sample.x * tangent.y + sample.y * normal.y + sample.z * bitangent.y,
@@ -200,10 +567,9 @@ Vector Renderer::traceRay(Ray &ray, const Scene &scene, const std::vector<std::s
     if(bounces > 0)
     {
       float q = 0.25;
-      if (rng.get() < q) break;
+      if (roulette < q) break;
       beta /= 1.0f - q;
     }
   }
-  delete[] lightSamples;
   return color;
 }
\ No newline at end of file
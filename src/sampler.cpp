@@ -0,0 +1,365 @@
+#include "sampler.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace
+{
+  const uint32_t PRIMES[] = {
+    2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37, 41, 43, 47, 53,
+    59, 61, 67, 71, 73, 79, 83, 89, 97, 101, 103, 107, 109, 113, 127, 131,
+    137, 139, 149, 151, 157, 163, 167, 173, 179, 181, 191, 193, 197, 199, 211, 223,
+    227, 229, 233, 239, 241, 251, 257, 263, 269, 271, 277, 281, 283, 293, 307, 311};
+  const uint32_t PRIME_COUNT = sizeof(PRIMES) / sizeof(PRIMES[0]);
+
+  const float ONE_MINUS_EPSILON = 0.99999994f;
+
+  uint32_t hash(uint64_t a, uint64_t b)
+  {
+    return (uint32_t)RNG::mix(RNG::mix(a) ^ b);
+  }
+
+  float toFloat(uint32_t x)
+  {
+    return (x >> 8) * (1.0f / 16777216.0f);
+  }
+
+  uint32_t reverseBits(uint32_t x)
+  {
+    x = (x << 16) | (x >> 16);
+    x = ((x & 0x00ff00ffu) << 8) | ((x & 0xff00ff00u) >> 8);
+    x = ((x & 0x0f0f0f0fu) << 4) | ((x & 0xf0f0f0f0u) >> 4);
+    x = ((x & 0x33333333u) << 2) | ((x & 0xccccccccu) >> 2);
+    x = ((x & 0x55555555u) << 1) | ((x & 0xaaaaaaaau) >> 1);
+    return x;
+  }
+
+  //Owen scrambling of the bits of x, most significant first (Burley, "Practical
+  //Hash-based Owen Scrambling"). Applied to an index it is a shuffle.
+  uint32_t nestedUniformScramble(uint32_t x, uint32_t seed)
+  {
+    x = reverseBits(x);
+    x ^= x * 0x3d20adeau;
+    x += seed;
+    x *= (seed >> 16) | 1;
+    x ^= x * 0x05526c56u;
+    x ^= x * 0x53a22864u;
+    return reverseBits(x);
+  }
+
+  //First two dimensions of the Sobol sequence as 32 bit fractions
+  uint32_t sobol0(uint32_t i)
+  {
+    return reverseBits(i);
+  }
+
+  //The second dimension is linear in the bits of i, so it is the xor of one
+  //table entry per byte of the (shuffled, hence full 32 bit) index
+  struct Sobol1Table
+  {
+    uint32_t bytes[4][256];
+
+    Sobol1Table()
+    {
+      uint32_t directions[32];
+      uint32_t v = 1u << 31;
+      for(int bit = 0; bit < 32; ++bit, v ^= v >> 1)
+        directions[bit] = v;
+
+      for(int byte = 0; byte < 4; ++byte)
+      {
+        for(uint32_t value = 0; value < 256; ++value)
+        {
+          uint32_t result = 0;
+          for(int bit = 0; bit < 8; ++bit)
+          {
+            if(value & (1u << bit)) result ^= directions[8*byte + bit];
+          }
+          bytes[byte][value] = result;
+        }
+      }
+    }
+  };
+
+  const Sobol1Table sobol1Table;
+
+  uint32_t sobol1(uint32_t i)
+  {
+    return sobol1Table.bytes[0][i & 0xff] ^ sobol1Table.bytes[1][(i >> 8) & 0xff] ^
+           sobol1Table.bytes[2][(i >> 16) & 0xff] ^ sobol1Table.bytes[3][i >> 24];
+  }
+
+  //Element i of a random permutation of [0, length) chosen by seed
+  //(Kensler, "Correlated Multi-Jittered Sampling")
+  uint32_t permutationElement(uint32_t i, uint32_t length, uint32_t seed)
+  {
+    uint32_t w = length - 1;
+    w |= w >> 1;
+    w |= w >> 2;
+    w |= w >> 4;
+    w |= w >> 8;
+    w |= w >> 16;
+    do
+    {
+      i ^= seed;
+      i *= 0xe170893du;
+      i ^= seed >> 16;
+      i ^= (i & w) >> 4;
+      i ^= seed >> 8;
+      i *= 0x0929eb3fu;
+      i ^= seed >> 23;
+      i ^= (i & w) >> 1;
+      i *= 1 | seed >> 27;
+      i *= 0x6935fa69u;
+      i ^= (i & w) >> 11;
+      i *= 0x74dcb303u;
+      i ^= (i & w) >> 2;
+      i *= 0x9e501cc3u;
+      i ^= (i & w) >> 2;
+      i *= 0xc860a3dfu;
+      i &= w;
+      i ^= i >> 5;
+    } while(i >= length);
+    return (i + seed) % length;
+  }
+
+  //Owen-scrambled radical inverse: every digit is permuted by a permutation chosen
+  //by the digits below it
+  float scrambledRadicalInverse(uint32_t base, uint32_t n, uint32_t seed)
+  {
+    float invBase = 1.0f / base, invBaseM = 1.0f;
+    uint64_t reversedDigits = 0;
+    while(n > 0 && 1.0f - (base - 1) * invBaseM < 1.0f)
+    {
+      uint32_t next = n / base;
+      uint32_t digit = n - next * base;
+      digit = permutationElement(digit, base, hash(seed, reversedDigits));
+      reversedDigits = reversedDigits * base + digit;
+      invBaseM *= invBase;
+      n = next;
+    }
+    //Once n runs out of digits, all remaining (zero) digits scrambled together are a
+    //uniform offset below the last digit
+    float tail = toFloat(hash(seed, reversedDigits)) * invBaseM;
+    return std::min(invBaseM * reversedDigits + tail, ONE_MINUS_EPSILON);
+  }
+
+  float wrap(float u)
+  {
+    u -= std::floor(u);
+    return std::min(u, ONE_MINUS_EPSILON);
+  }
+
+  //Ranks of a 64x64 void-and-cluster blue noise mask (Ulichney), generated once
+  const int MASK_SIZE = 64;
+
+  std::vector<uint16_t> createBlueNoiseMask()
+  {
+    const int N = MASK_SIZE, S = N * N;
+    const float sigma = 1.5f;
+
+    std::vector<float> kernel(S);
+    for(int y = 0; y < N; ++y)
+    {
+      for(int x = 0; x < N; ++x)
+      {
+        int dx = std::min(x, N - x), dy = std::min(y, N - y);
+        kernel[y * N + x] = std::exp(-(dx * dx + dy * dy) / (2.0f * sigma * sigma));
+      }
+    }
+
+    std::vector<char> bits(S, 0);
+    std::vector<float> energy(S, 0.0f);
+    auto toggle = [&](int p, bool on)
+    {
+      bits[p] = on;
+      int px = p % N, py = p / N;
+      float sign = on ? 1.0f : -1.0f;
+      for(int y = 0; y < N; ++y)
+      {
+        const float* row = &kernel[((y - py + N) % N) * N];
+        for(int x = 0; x < N; ++x)
+          energy[y * N + x] += sign * row[(x - px + N) % N];
+      }
+    };
+    auto tightestCluster = [&]()
+    {
+      int best = -1;
+      for(int p = 0; p < S; ++p)
+      {
+        if(bits[p] && (best < 0 || energy[p] > energy[best])) best = p;
+      }
+      return best;
+    };
+    auto largestVoid = [&]()
+    {
+      int best = -1;
+      for(int p = 0; p < S; ++p)
+      {
+        if(!bits[p] && (best < 0 || energy[p] < energy[best])) best = p;
+      }
+      return best;
+    };
+
+    //Initial pattern: random points relaxed until the tightest cluster is the largest void
+    RNG rng(0x5eed);
+    const int ones = S / 10;
+    for(int placed = 0; placed < ones;)
+    {
+      int p = rng.getUInt() % S;
+      if(bits[p]) continue;
+      toggle(p, true);
+      ++placed;
+    }
+    for(;;)
+    {
+      int cluster = tightestCluster();
+      toggle(cluster, false);
+      int gap = largestVoid();
+      toggle(gap, true);
+      if(gap == cluster) break;
+    }
+
+    std::vector<uint16_t> rank(S);
+    std::vector<char> initialBits = bits;
+    std::vector<float> initialEnergy = energy;
+    for(int r = ones - 1; r >= 0; --r)
+    {
+      int cluster = tightestCluster();
+      toggle(cluster, false);
+      rank[cluster] = r;
+    }
+
+    bits = initialBits;
+    energy = initialEnergy;
+    for(int r = ones; r < S; ++r)
+    {
+      int gap = largestVoid();
+      toggle(gap, true);
+      rank[gap] = r;
+    }
+    return rank;
+  }
+
+  const std::vector<uint16_t>& getBlueNoiseMask()
+  {
+    static const std::vector<uint16_t> mask = createBlueNoiseMask();
+    return mask;
+  }
+}
+
+void Sampler::get2DArray(unsigned int count, float* u)
+{
+  uint64_t seed = RNG::mix(pixelDimensionSeed() ^ m_index);
+  uint32_t seed0 = (uint32_t)seed, seed1 = (uint32_t)(seed >> 32);
+  for(unsigned int i = 0; i < count; ++i)
+  {
+    u[2*i] = toFloat(nestedUniformScramble(sobol0(i), seed0));
+    u[2*i + 1] = toFloat(nestedUniformScramble(sobol1(i), seed1));
+  }
+  m_dimension += 2;
+}
+
+std::unique_ptr<Sampler> Sampler::create(SamplerType type, uint64_t seed)
+{
+  switch(type)
+  {
+  case SamplerType::Random: return std::unique_ptr<Sampler>(new RandomSampler(seed));
+  case SamplerType::Halton: return std::unique_ptr<Sampler>(new HaltonSampler(seed));
+  case SamplerType::BlueNoise: return std::unique_ptr<Sampler>(new BlueNoiseSampler(seed));
+  default: return std::unique_ptr<Sampler>(new SobolSampler(seed));
+  }
+}
+
+const char* Sampler::getName(SamplerType type)
+{
+  switch(type)
+  {
+  case SamplerType::Random: return "random";
+  case SamplerType::Halton: return "Halton";
+  case SamplerType::BlueNoise: return "blue noise";
+  default: return "Sobol";
+  }
+}
+
+void RandomSampler::startSample(unsigned int x, unsigned int y, uint32_t index)
+{
+  Sampler::startSample(x, y, index);
+  m_rng = RNG::forSample(m_seed, ((uint64_t)y << 32) | x, index);
+}
+
+float RandomSampler::get1D()
+{
+  ++m_dimension;
+  return m_rng.get();
+}
+
+void RandomSampler::get2D(float& u1, float& u2)
+{
+  m_dimension += 2;
+  u1 = m_rng.get();
+  u2 = m_rng.get();
+}
+
+//The low half of the seed shuffles the index, the high half scrambles the values
+float SobolSampler::get1D()
+{
+  uint64_t seed = pixelDimensionSeed();
+  uint32_t index = nestedUniformScramble(m_index, (uint32_t)seed);
+  ++m_dimension;
+  return toFloat(nestedUniformScramble(sobol0(index), (uint32_t)(seed >> 32)));
+}
+
+void SobolSampler::get2D(float& u1, float& u2)
+{
+  uint64_t seed = pixelDimensionSeed();
+  uint32_t index = nestedUniformScramble(m_index, (uint32_t)seed);
+  m_dimension += 2;
+  u1 = toFloat(nestedUniformScramble(sobol0(index), (uint32_t)(seed >> 32)));
+  u2 = toFloat(nestedUniformScramble(sobol1(index), (uint32_t)(seed >> 32) ^ 0x9e3779b9u));
+}
+
+float HaltonSampler::get1D()
+{
+  uint32_t seed = (uint32_t)pixelDimensionSeed();
+  uint32_t dimension = m_dimension++;
+  //Dimensions past the prime table are plain hashed random numbers
+  if(dimension >= PRIME_COUNT) return toFloat(hash(seed, m_index));
+  return scrambledRadicalInverse(PRIMES[dimension], m_index, seed);
+}
+
+void HaltonSampler::get2D(float& u1, float& u2)
+{
+  u1 = get1D();
+  u2 = get1D();
+}
+
+float BlueNoiseSampler::getShift(uint32_t dimension) const
+{
+  const std::vector<uint16_t>& mask = getBlueNoiseMask();
+  uint32_t offset = hash(m_seed, dimension);
+  unsigned int x = (m_x + offset) % MASK_SIZE;
+  unsigned int y = (m_y + (offset >> 16)) % MASK_SIZE;
+  return (mask[y * MASK_SIZE + x] + 0.5f) / (MASK_SIZE * MASK_SIZE);
+}
+
+float BlueNoiseSampler::get1D()
+{
+  //The same points for every pixel, only the shift differs
+  uint64_t seed = RNG::mix(m_seed ^ m_dimension);
+  uint32_t index = nestedUniformScramble(m_index, (uint32_t)seed);
+  float u = toFloat(nestedUniformScramble(sobol0(index), (uint32_t)(seed >> 32)));
+  u = wrap(u + getShift(m_dimension));
+  ++m_dimension;
+  return u;
+}
+
+void BlueNoiseSampler::get2D(float& u1, float& u2)
+{
+  uint64_t seed = RNG::mix(m_seed ^ m_dimension);
+  uint32_t index = nestedUniformScramble(m_index, (uint32_t)seed);
+  u1 = wrap(toFloat(nestedUniformScramble(sobol0(index), (uint32_t)(seed >> 32))) + getShift(m_dimension));
+  u2 = wrap(toFloat(nestedUniformScramble(sobol1(index), (uint32_t)(seed >> 32) ^ 0x9e3779b9u)) + getShift(m_dimension + 1));
+  m_dimension += 2;
+}
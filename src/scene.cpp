@@ -1,33 +1,181 @@
-
 #include "scene.hpp"
 #include "object.hpp"
 
-std::shared_ptr<Object> Scene::intersect(const Ray& ray, float* intersectionT) const
+void Scene::build(Acceleration acceleration)
+{
+  m_acceleration = acceleration;
+  m_bounded.clear();
+  m_unbounded.clear();
+  m_bvh.clear();
+  m_bvhOwner.reset();
+  m_compiled.clear();
+
+  if(acceleration == Acceleration::Compiled)
+  {
+    m_compiled.build(m_objects);
+    m_built = true;
+    return;
+  }
+
+  std::vector<const Object*> finite;
+  std::vector<AABB> bounds;
+  for(size_t i = 0; i < m_objects.size(); ++i)
+  {
+    if(m_objects[i]->isFinite())
+    {
+      AABB box = m_objects[i]->getBoundingBox();
+      //Flat shapes would get zero-thickness boxes
+      box.pad(0.0001f);
+      finite.push_back(m_objects[i].get());
+      bounds.push_back(box);
+    }
+    else
+      m_unbounded.push_back(m_objects[i].get());
+  }
+
+  m_bvh.build(bounds);
+  const std::vector<unsigned int>& indices = m_bvh.getIndices();
+  m_bounded.reserve(indices.size());
+  for(size_t i = 0; i < indices.size(); ++i)
+    m_bounded.push_back(finite[indices[i]]);
+
+  m_built = true;
+}
+
+bool Scene::build(const BVHNode* nodes, size_t nodeCount, const unsigned int* indices, size_t indexCount, std::shared_ptr<const void> owner)
+{
+  m_acceleration = Acceleration::BVH;
+  m_bounded.clear();
+  m_unbounded.clear();
+  m_bvh.clear();
+  m_bvhOwner.reset();
+  m_compiled.clear();
+  m_built = false;
+
+  std::vector<const Object*> finite;
+  for(size_t i = 0; i < m_objects.size(); ++i)
+  {
+    if(m_objects[i]->isFinite())
+      finite.push_back(m_objects[i].get());
+    else
+      m_unbounded.push_back(m_objects[i].get());
+  }
+
+  if(indexCount != finite.size() || !m_bvh.adopt(nodes, nodeCount, indexCount))
+  {
+    m_unbounded.clear();
+    return false;
+  }
+  m_bounded.reserve(indexCount);
+  for(size_t i = 0; i < indexCount; ++i)
+  {
+    if(indices[i] >= finite.size())
+    {
+      m_bounded.clear();
+      m_unbounded.clear();
+      m_bvh.clear();
+      return false;
+    }
+    m_bounded.push_back(finite[indices[i]]);
+  }
+
+  m_bvhOwner = std::move(owner);
+  m_built = true;
+  return true;
+}
+
+const Object* Scene::intersect(const Ray& ray, float* intersectionT, unsigned int* primitive) const
 {
-  std::shared_ptr<Object> object = nullptr;
+  if(!m_built) return intersectLinear(ray, intersectionT, primitive);
+  if(m_acceleration == Acceleration::Compiled)
+  {
+    float closestT = 10e6;
+    unsigned int closestPrim;
+    int hit = m_compiled.intersect(ray, closestT, closestPrim);
+    *intersectionT = closestT;
+    if(primitive) *primitive = closestPrim;
+    return hit >= 0 ? m_objects[hit].get() : nullptr;
+  }
+
+  const Object* object = nullptr;
   float closestT = 10e6;
   float t;
-  for(size_t i = 0; i < m_objects.size(); ++i)
+  unsigned int prim, closestPrim = 0;
+  for(size_t i = 0; i < m_unbounded.size(); ++i)
   {
-    t = m_objects[i]->intersect(ray);
+    t = m_unbounded[i]->intersectPrimitive(ray, prim);
     if(t > 0.0f && t < closestT)
     {
-      object = m_objects[i];
+      object = m_unbounded[i];
       closestT = t;
+      closestPrim = prim;
     }
   }
+
+  int hit = -1;
+  m_bvh.intersect(ray, closestT, [&](unsigned int i, float& tMax)
+  {
+    float t = m_bounded[i]->intersectPrimitive(ray, prim);
+    if(t > 0.0f && t < tMax)
+    {
+      tMax = t;
+      hit = i;
+      closestPrim = prim;
+      return true;
+    }
+    return false;
+  });
+  if(hit >= 0) object = m_bounded[hit];
+
   *intersectionT = closestT;
+  if(primitive) *primitive = closestPrim;
   return object;
 }
 
 bool Scene::occlusionTest(const Ray& ray, float maxT) const
 {
+  if(!m_built) return occlusionTestLinear(ray, maxT);
+  if(m_acceleration == Acceleration::Compiled) return m_compiled.occlusionTest(ray, maxT);
+
+  for(size_t i = 0; i < m_unbounded.size(); ++i)
+  {
+    if(m_unbounded[i]->occludes(ray, maxT))
+      return true;
+  }
+
+  return m_bvh.occluded(ray, maxT, [&](unsigned int i)
+  {
+    return m_bounded[i]->occludes(ray, maxT);
+  });
+}
+
+const Object* Scene::intersectLinear(const Ray& ray, float* intersectionT, unsigned int* primitive) const
+{
+  const Object* object = nullptr;
+  float closestT = 10e6;
   float t;
+  unsigned int prim, closestPrim = 0;
   for(size_t i = 0; i < m_objects.size(); ++i)
   {
-    t = m_objects[i]->intersect(ray);
-    if(t > 0.0f && (t < maxT || maxT < 0.0f))
+    t = m_objects[i]->intersectPrimitive(ray, prim);
+    if(t > 0.0f && t < closestT)
+    {
+      object = m_objects[i].get();
+      closestT = t;
+      closestPrim = prim;
+    }
+  }
+  *intersectionT = closestT;
+  if(primitive) *primitive = closestPrim;
+  return object;
+}
+
+bool Scene::occlusionTestLinear(const Ray& ray, float maxT) const
+{
+  for(size_t i = 0; i < m_objects.size(); ++i)
+  {
+    if(m_objects[i]->occludes(ray, maxT))
       return true;
   }
   return false;
-}
\ No newline at end of file
+}
@@ -0,0 +1,603 @@
+#include "sceneFile.hpp"
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "scene.hpp"
+#include "camera.hpp"
+#include "mappedFile.hpp"
+#include "objLoader.hpp"
+#include "triangleMesh.hpp"
+#include "sphere.hpp"
+#include "rectangle.hpp"
+#include "ellipse.hpp"
+#include "plane.hpp"
+#include "pointLight.hpp"
+#include "directionalLight.hpp"
+#include "solidMaterial.hpp"
+#include "texturedMaterial.hpp"
+#include "textureRegistry.hpp"
+
+//Arrays of the file are used in place
+static_assert(sizeof(Vector) == 3 * sizeof(float), "Vector has to be 3 packed floats");
+static_assert(sizeof(BVHNode) == 32, "BVHNode layout changed");
+
+namespace
+{
+  const char SCENE_MAGIC[4] = {'P', 'T', 'S', 'C'};
+  const uint32_t SCENE_VERSION = 1;
+  //Files are written in the byte order of the host and only read on hosts with the same one
+  const uint32_t BYTE_ORDER_MARK = 0x01020304;
+  const uint32_t NONE = 0xffffffffu;
+  const uint64_t ALIGNMENT = 16;
+
+  enum ObjectType : uint32_t
+  {
+    OBJECT_SPHERE,
+    OBJECT_RECTANGLE,
+    OBJECT_ELLIPSE,
+    OBJECT_PLANE,
+    OBJECT_MESH
+  };
+  enum MaterialType : uint32_t
+  {
+    MATERIAL_SOLID,
+    MATERIAL_TEXTURED
+  };
+  enum LightType : uint32_t
+  {
+    LIGHT_POINT,
+    LIGHT_DIRECTIONAL
+  };
+
+  struct Table
+  {
+    uint64_t offset, count;
+  };
+  struct CameraRecord
+  {
+    float fov;
+    float position[3], forward[3], up[3];
+  };
+  //A constant color unless texture is set
+  struct EnvironmentRecord
+  {
+    uint32_t texture;
+    float color[3];
+  };
+  //path is the offset of a zero-terminated string in the string table
+  struct TextureRecord
+  {
+    uint32_t path;
+    uint32_t flipV;
+  };
+  //Textured materials emit emittance * intensity unless emissionTexture is set
+  struct MaterialRecord
+  {
+    uint32_t type;
+    uint32_t texture, emissionTexture;
+    float color[3];
+    float diffuse;
+    float emittance[3];
+    float intensity;
+  };
+  //values: point or center, normal, tangent, bitangent (used if axes is 3), sizes or semi-axes
+  //along the tangent and the bitangent. Spheres keep the radius in values[12].
+  struct ObjectRecord
+  {
+    uint32_t type;
+    uint32_t material;
+    uint32_t mesh;
+    uint32_t axes;
+    float values[14];
+  };
+  struct LightRecord
+  {
+    uint32_t type;
+    float vector[3];
+    float color[3];
+    float intensity;
+  };
+  //Offsets from the start of the file, 0 for missing normals or uvs. Triangles are stored
+  //in the leaf order of the nodes.
+  struct MeshRecord
+  {
+    uint64_t positions, normals, uvs, indices, areaCDF, nodes;
+    uint64_t vertexCount, triangleCount, nodeCount;
+  };
+  struct FileHeader
+  {
+    char magic[4];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint32_t reserved;
+    CameraRecord camera;
+    EnvironmentRecord environment;
+    Table strings, textures, materials, objects, lights, meshes;
+    //Hierarchy over the finite objects and the position among those of every leaf primitive
+    Table nodes, nodeIndices;
+  };
+
+  Vector toVector(const float* values)
+  {
+    return Vector(values[0], values[1], values[2]);
+  }
+
+  //Object of a record, mesh records use mesh
+  std::shared_ptr<Object> createObject(const ObjectRecord& record, std::shared_ptr<BaseMaterial> material, std::shared_ptr<TriangleMesh> mesh)
+  {
+    const float* v = record.values;
+    switch(record.type)
+    {
+      case OBJECT_SPHERE:
+        return std::make_shared<Sphere>(toVector(v), v[12], material);
+      case OBJECT_RECTANGLE:
+        if(record.axes == 3)
+          return std::make_shared<Rectangle>(toVector(v), toVector(v + 3), toVector(v + 6), toVector(v + 9), v[12], v[13], material);
+        return std::make_shared<Rectangle>(toVector(v), toVector(v + 3), toVector(v + 6), v[12], v[13], material);
+      case OBJECT_ELLIPSE:
+        if(record.axes == 3)
+          return std::make_shared<Ellipse>(toVector(v), toVector(v + 3), toVector(v + 6), toVector(v + 9), v[12], v[13], material);
+        return std::make_shared<Ellipse>(toVector(v), toVector(v + 3), toVector(v + 6), v[12], v[13], material);
+      case OBJECT_PLANE:
+        return std::make_shared<Plane>(toVector(v), toVector(v + 3), material);
+      case OBJECT_MESH:
+        return mesh;
+    }
+    return nullptr;
+  }
+
+  //Tokens of one line of a text scene
+  class LineReader
+  {
+  private:
+    std::vector<std::string> m_tokens;
+    size_t m_next;
+  public:
+    explicit LineReader(const std::string& line): m_next(0)
+    {
+      std::istringstream stream(line.substr(0, line.find('#')));
+      std::string token;
+      while(stream >> token) m_tokens.push_back(token);
+    }
+
+    size_t getTokenCount() const { return m_tokens.size(); }
+    bool isDone() const { return m_next == m_tokens.size(); }
+
+    bool word(std::string& value)
+    {
+      if(m_next == m_tokens.size()) return false;
+      value = m_tokens[m_next++];
+      return true;
+    }
+    bool number(float& value)
+    {
+      if(m_next == m_tokens.size()) return false;
+      const char* token = m_tokens[m_next].c_str();
+      char* end = nullptr;
+      value = std::strtof(token, &end);
+      if(end == token || *end != '\0') return false;
+      ++m_next;
+      return true;
+    }
+    bool numbers(float* values, int count)
+    {
+      for(int i = 0; i < count; ++i)
+      {
+        if(!number(values[i])) return false;
+      }
+      return true;
+    }
+  };
+
+  //Records of a text scene on their way to the file
+  struct SceneText
+  {
+    CameraRecord camera;
+    EnvironmentRecord environment;
+    std::string strings;
+    std::vector<TextureRecord> textures;
+    std::vector<MaterialRecord> materials;
+    std::vector<ObjectRecord> objects;
+    std::vector<LightRecord> lights;
+    std::vector<std::shared_ptr<TriangleMesh>> meshes;
+    std::map<std::string, uint32_t> textureNames, materialNames;
+  };
+
+  std::string resolvePath(const std::string& directory, const std::string& path)
+  {
+    return path.empty() || path[0] == '/' ? path : directory + path;
+  }
+
+  bool lookUp(const std::map<std::string, uint32_t>& names, const std::string& name, uint32_t& index)
+  {
+    auto it = names.find(name);
+    if(it == names.end()) return false;
+    index = it->second;
+    return true;
+  }
+
+  bool parseLine(LineReader& line, const std::string& directory, SceneText& text)
+  {
+    std::string keyword, name;
+    line.word(keyword);
+
+    if(keyword == "camera")
+    {
+      CameraRecord& c = text.camera;
+      return line.number(c.fov) && line.numbers(c.position, 3) && line.numbers(c.forward, 3) && line.numbers(c.up, 3) && line.isDone();
+    }
+    if(keyword == "environment")
+    {
+      EnvironmentRecord& e = text.environment;
+      e.texture = NONE;
+      if(line.getTokenCount() == 4) return line.numbers(e.color, 3);
+      return line.word(name) && lookUp(text.textureNames, name, e.texture) && line.isDone();
+    }
+    if(keyword == "texture")
+    {
+      std::string path, flip;
+      if(!line.word(name) || !line.word(path) || text.textureNames.count(name)) return false;
+      TextureRecord record;
+      record.flipV = line.word(flip) && flip == "flip";
+      if(!flip.empty() && !record.flipV) return false;
+      record.path = text.strings.size();
+      text.strings += resolvePath(directory, path);
+      text.strings += '\0';
+      text.textureNames[name] = text.textures.size();
+      text.textures.push_back(record);
+      return line.isDone();
+    }
+    if(keyword == "material")
+    {
+      std::string type, texture;
+      if(!line.word(name) || !line.word(type) || text.materialNames.count(name)) return false;
+      MaterialRecord record = {};
+      record.texture = record.emissionTexture = NONE;
+      if(type == "solid")
+      {
+        record.type = MATERIAL_SOLID;
+        if(!line.numbers(record.color, 3) || !line.number(record.diffuse)) return false;
+        if(!line.isDone() && !line.numbers(record.emittance, 3)) return false;
+      }
+      else if(type == "textured")
+      {
+        record.type = MATERIAL_TEXTURED;
+        if(!line.word(texture) || !lookUp(text.textureNames, texture, record.texture) || !line.number(record.diffuse)) return false;
+        //Optionally followed by an emission texture or color and its intensity
+        if(line.getTokenCount() == 7)
+        {
+          if(!line.word(texture) || !lookUp(text.textureNames, texture, record.emissionTexture) || !line.number(record.intensity)) return false;
+        }
+        else if(line.getTokenCount() == 9)
+        {
+          if(!line.numbers(record.emittance, 3) || !line.number(record.intensity)) return false;
+        }
+      }
+      else return false;
+      text.materialNames[name] = text.materials.size();
+      text.materials.push_back(record);
+      return line.isDone();
+    }
+    if(keyword == "pointlight" || keyword == "directionallight")
+    {
+      LightRecord record;
+      record.type = keyword == "pointlight" ? LIGHT_POINT : LIGHT_DIRECTIONAL;
+      if(!line.numbers(record.vector, 3) || !line.numbers(record.color, 3) || !line.number(record.intensity)) return false;
+      text.lights.push_back(record);
+      return line.isDone();
+    }
+
+    ObjectRecord record = {};
+    record.mesh = NONE;
+    float* v = record.values;
+    if(keyword == "sphere")
+    {
+      record.type = OBJECT_SPHERE;
+      if(!line.numbers(v, 3) || !line.number(v[12])) return false;
+    }
+    else if(keyword == "rectangle" || keyword == "ellipse")
+    {
+      //The bitangent is optional
+      record.type = keyword == "rectangle" ? OBJECT_RECTANGLE : OBJECT_ELLIPSE;
+      record.axes = line.getTokenCount() == 16 ? 3 : 2;
+      if(!line.numbers(v, 3 * (record.axes + 1)) || !line.numbers(v + 12, 2)) return false;
+    }
+    else if(keyword == "plane")
+    {
+      record.type = OBJECT_PLANE;
+      if(!line.numbers(v, 6)) return false;
+    }
+    else if(keyword == "mesh")
+    {
+      std::string path;
+      MeshData data;
+      if(!line.word(path)) return false;
+      path = resolvePath(directory, path);
+      if(!loadOBJ(path.c_str(), data))
+      {
+        std::cout << "ERROR: Mesh (" << path << ") could not be loaded!\n";
+        return false;
+      }
+      record.type = OBJECT_MESH;
+      record.mesh = text.meshes.size();
+      text.meshes.push_back(std::make_shared<TriangleMesh>(std::move(data)));
+    }
+    else return false;
+
+    if(!line.word(name) || !lookUp(text.materialNames, name, record.material)) return false;
+    text.objects.push_back(record);
+    return line.isDone();
+  }
+
+  //Writes arrays one after another, every one aligned to ALIGNMENT
+  class FileWriter
+  {
+  private:
+    std::ofstream m_file;
+    uint64_t m_size;
+  public:
+    explicit FileWriter(const char* fileName): m_file(fileName, std::ios::binary | std::ios::trunc), m_size(0) {}
+
+    bool isOpen() const { return m_file.is_open(); }
+    bool isGood() const { return (bool)m_file; }
+
+    //Offset of the data in the file
+    uint64_t write(const void* data, uint64_t size)
+    {
+      static const char padding[ALIGNMENT] = {};
+      uint64_t aligned = (m_size + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+      m_file.write(padding, aligned - m_size);
+      m_file.write((const char*)data, size);
+      m_size = aligned + size;
+      return aligned;
+    }
+    template<typename T>
+    Table writeTable(const T* data, size_t count)
+    {
+      return {count > 0 ? write(data, count * sizeof(T)) : 0, count};
+    }
+    void writeAt(uint64_t offset, const void* data, uint64_t size)
+    {
+      m_file.seekp(offset);
+      m_file.write((const char*)data, size);
+    }
+  };
+
+  //Checked access to the arrays of a mapped file
+  class FileReader
+  {
+  private:
+    const uint8_t* m_data;
+    uint64_t m_size;
+  public:
+    FileReader(const uint8_t* data, uint64_t size): m_data(data), m_size(size) {}
+
+    //Null unless count elements at offset lie within the file and are aligned
+    template<typename T>
+    const T* get(uint64_t offset, uint64_t count) const
+    {
+      if(offset % ALIGNMENT != 0 || offset > m_size || count > (m_size - offset) / sizeof(T)) return nullptr;
+      return (const T*)(m_data + offset);
+    }
+    template<typename T>
+    const T* get(const Table& table) const
+    {
+      return get<T>(table.offset, table.count);
+    }
+  };
+
+  bool createMeshView(const FileReader& file, const MeshRecord& record, MeshView& view)
+  {
+    if(record.vertexCount > NONE || record.triangleCount > NONE / 3) return false;
+    view.vertexCount = record.vertexCount;
+    view.triangleCount = record.triangleCount;
+    view.nodeCount = record.nodeCount;
+    view.positions = file.get<Vector>(record.positions, record.vertexCount);
+    view.normals = record.normals ? file.get<Vector>(record.normals, record.vertexCount) : nullptr;
+    view.uvs = record.uvs ? file.get<float>(record.uvs, 2 * record.vertexCount) : nullptr;
+    view.indices = file.get<unsigned int>(record.indices, 3 * record.triangleCount);
+    view.areaCDF = file.get<float>(record.areaCDF, record.triangleCount);
+    view.nodes = file.get<BVHNode>(record.nodes, record.nodeCount);
+    if((record.normals && !view.normals) || (record.uvs && !view.uvs)) return false;
+    return view.triangleCount > 0 && TriangleMesh::isValidView(view);
+  }
+}
+
+bool compileScene(const char* textFile, const char* binaryFile)
+{
+  std::ifstream input(textFile);
+  if(!input.is_open())
+  {
+    std::cout << "ERROR: Scene (" << textFile << ") could not be loaded!\n";
+    return false;
+  }
+  std::string directory = textFile;
+  directory = directory.substr(0, directory.find_last_of('/') + 1);
+
+  SceneText text;
+  text.camera = {90.0f, {0, 0, -1}, {0, 0, 1}, {0, 1, 0}};
+  text.environment = {NONE, {0, 0, 0}};
+  std::string line;
+  for(unsigned int number = 1; std::getline(input, line); ++number)
+  {
+    LineReader reader(line);
+    if(reader.getTokenCount() == 0) continue;
+    if(!parseLine(reader, directory, text))
+    {
+      std::cout << "ERROR: Invalid line " << number << " of scene (" << textFile << "): " << line << "\n";
+      return false;
+    }
+  }
+
+  //The hierarchy over the objects, built the way Scene::build builds it
+  Scene scene;
+  for(size_t i = 0; i < text.objects.size(); ++i)
+  {
+    const ObjectRecord& record = text.objects[i];
+    scene.addObject(createObject(record, nullptr, record.type == OBJECT_MESH ? text.meshes[record.mesh] : nullptr));
+  }
+  scene.build();
+  const BVH& bvh = scene.getBVH();
+
+  FileWriter output(binaryFile);
+  if(!output.isOpen())
+  {
+    std::cout << "ERROR: Scene (" << binaryFile << ") could not be saved!\n";
+    return false;
+  }
+  FileHeader header = {};
+  std::memcpy(header.magic, SCENE_MAGIC, sizeof(header.magic));
+  header.version = SCENE_VERSION;
+  header.byteOrder = BYTE_ORDER_MARK;
+  header.camera = text.camera;
+  header.environment = text.environment;
+  output.write(&header, sizeof(header));
+
+  std::vector<MeshRecord> meshes(text.meshes.size());
+  for(size_t i = 0; i < meshes.size(); ++i)
+  {
+    const MeshView& view = text.meshes[i]->getView();
+    MeshRecord& record = meshes[i];
+    record.vertexCount = view.vertexCount;
+    record.triangleCount = view.triangleCount;
+    record.nodeCount = view.nodeCount;
+    record.positions = output.write(view.positions, view.vertexCount * sizeof(Vector));
+    record.normals = view.normals ? output.write(view.normals, view.vertexCount * sizeof(Vector)) : 0;
+    record.uvs = view.uvs ? output.write(view.uvs, 2 * view.vertexCount * sizeof(float)) : 0;
+    record.indices = output.write(view.indices, 3 * view.triangleCount * sizeof(unsigned int));
+    record.areaCDF = output.write(view.areaCDF, view.triangleCount * sizeof(float));
+    record.nodes = output.write(view.nodes, view.nodeCount * sizeof(BVHNode));
+  }
+
+  header.strings = output.writeTable(text.strings.data(), text.strings.size());
+  header.textures = output.writeTable(text.textures.data(), text.textures.size());
+  header.materials = output.writeTable(text.materials.data(), text.materials.size());
+  header.objects = output.writeTable(text.objects.data(), text.objects.size());
+  header.lights = output.writeTable(text.lights.data(), text.lights.size());
+  header.meshes = output.writeTable(meshes.data(), meshes.size());
+  header.nodes = output.writeTable(bvh.getNodes(), bvh.getNodeCount());
+  header.nodeIndices = output.writeTable(bvh.getIndices().data(), bvh.getIndices().size());
+  output.writeAt(0, &header, sizeof(header));
+
+  if(!output.isGood())
+  {
+    std::cout << "ERROR: Scene (" << binaryFile << ") could not be saved!\n";
+    return false;
+  }
+  return true;
+}
+
+bool loadCompiledScene(const char* fileName, Scene& scene, Camera& camera)
+{
+  std::shared_ptr<MappedFile> mapping = std::make_shared<MappedFile>(fileName);
+  FileHeader header;
+  if(!mapping->isOpen() || mapping->getSize() < sizeof(header))
+  {
+    std::cout << "ERROR: Scene (" << fileName << ") could not be loaded!\n";
+    return false;
+  }
+  std::memcpy(&header, mapping->getData(), sizeof(header));
+  if(std::memcmp(header.magic, SCENE_MAGIC, sizeof(header.magic)) != 0 || header.version != SCENE_VERSION || header.byteOrder != BYTE_ORDER_MARK)
+  {
+    std::cout << "ERROR: " << fileName << " is not a compiled scene of this version!\n";
+    return false;
+  }
+
+  auto invalid = [fileName](const char* what)
+  {
+    std::cout << "ERROR: Scene (" << fileName << ") has invalid " << what << "!\n";
+    return false;
+  };
+
+  FileReader file(mapping->getData(), mapping->getSize());
+  const char* strings = file.get<char>(header.strings);
+  const TextureRecord* textureRecords = file.get<TextureRecord>(header.textures);
+  const MaterialRecord* materialRecords = file.get<MaterialRecord>(header.materials);
+  const ObjectRecord* objectRecords = file.get<ObjectRecord>(header.objects);
+  const LightRecord* lightRecords = file.get<LightRecord>(header.lights);
+  const MeshRecord* meshRecords = file.get<MeshRecord>(header.meshes);
+  const BVHNode* nodes = file.get<BVHNode>(header.nodes);
+  const unsigned int* nodeIndices = file.get<unsigned int>(header.nodeIndices);
+  if(!strings || !textureRecords || !materialRecords || !objectRecords || !lightRecords || !meshRecords || !nodes || !nodeIndices)
+    return invalid("tables");
+
+  TextureRegistry registry;
+  std::vector<Texture> textures;
+  for(uint64_t i = 0; i < header.textures.count; ++i)
+  {
+    const TextureRecord& record = textureRecords[i];
+    if(record.path >= header.strings.count || !std::memchr(strings + record.path, '\0', header.strings.count - record.path))
+      return invalid("texture paths");
+    textures.push_back(registry.get(strings + record.path, record.flipV != 0));
+  }
+
+  std::vector<std::shared_ptr<BaseMaterial>> materials;
+  for(uint64_t i = 0; i < header.materials.count; ++i)
+  {
+    const MaterialRecord& record = materialRecords[i];
+    if(record.type == MATERIAL_SOLID)
+      materials.push_back(std::make_shared<SolidMaterial>(toVector(record.color), record.diffuse, toVector(record.emittance)));
+    else if(record.type == MATERIAL_TEXTURED && record.texture < textures.size())
+    {
+      const Texture& texture = textures[record.texture];
+      if(record.emissionTexture == NONE)
+        materials.push_back(std::make_shared<TexturedMaterial>(texture, record.diffuse, toVector(record.emittance), record.intensity));
+      else if(record.emissionTexture < textures.size())
+        materials.push_back(std::make_shared<TexturedMaterial>(texture, record.diffuse, textures[record.emissionTexture], record.intensity));
+      else return invalid("materials");
+    }
+    else return invalid("materials");
+  }
+
+  std::vector<MeshView> meshes(header.meshes.count);
+  for(size_t i = 0; i < meshes.size(); ++i)
+  {
+    if(!createMeshView(file, meshRecords[i], meshes[i]))
+      return invalid("meshes");
+  }
+
+  for(uint64_t i = 0; i < header.objects.count; ++i)
+  {
+    const ObjectRecord& record = objectRecords[i];
+    if(record.type > OBJECT_MESH || record.material >= materials.size() || (record.type == OBJECT_MESH && record.mesh >= meshes.size()))
+      return invalid("objects");
+    //The material belongs to the object, objects sharing geometry get meshes of their own
+    std::shared_ptr<TriangleMesh> mesh;
+    if(record.type == OBJECT_MESH)
+      mesh = std::make_shared<TriangleMesh>(meshes[record.mesh], mapping, materials[record.material]);
+    scene.addObject(createObject(record, materials[record.material], mesh));
+  }
+
+  for(uint64_t i = 0; i < header.lights.count; ++i)
+  {
+    const LightRecord& record = lightRecords[i];
+    if(record.type == LIGHT_POINT)
+      scene.addLight(std::make_shared<PointLight>(toVector(record.vector), toVector(record.color), record.intensity));
+    else if(record.type == LIGHT_DIRECTIONAL)
+      scene.addLight(std::make_shared<DirectionalLight>(toVector(record.vector), toVector(record.color), record.intensity));
+    else return invalid("lights");
+  }
+
+  const EnvironmentRecord& environment = header.environment;
+  if(environment.texture == NONE)
+    scene.setEnvironmentMap(EnvironmentMap(toVector(environment.color)));
+  else if(environment.texture < textures.size())
+    scene.setEnvironmentMap(EnvironmentMap(textures[environment.texture]));
+  else return invalid("environment");
+
+  const CameraRecord& c = header.camera;
+  camera = Camera(c.fov, toVector(c.position), toVector(c.forward), toVector(c.up));
+
+  if(!scene.build(nodes, header.nodes.count, nodeIndices, header.nodeIndices.count, mapping))
+    return invalid("hierarchy");
+  return true;
+}
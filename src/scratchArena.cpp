@@ -0,0 +1,23 @@
+#include "scratchArena.hpp"
+
+ScratchArena::ScratchArena(size_t capacity): m_block(new char[capacity]), m_capacity(capacity), m_used(0), m_overflowSize(0) {}
+
+void* ScratchArena::allocateOverflow(size_t bytes)
+{
+  //new[] of char is aligned for any fundamental type
+  m_overflow.emplace_back(new char[bytes]);
+  m_overflowSize += bytes + alignof(std::max_align_t);
+  return m_overflow.back().get();
+}
+
+void ScratchArena::reset()
+{
+  if(!m_overflow.empty())
+  {
+    m_capacity += m_overflowSize;
+    m_block.reset(new char[m_capacity]);
+    m_overflow.clear();
+    m_overflowSize = 0;
+  }
+  m_used = 0;
+}
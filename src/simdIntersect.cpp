@@ -0,0 +1,143 @@
+#include "simdKernels.hpp"
+
+namespace
+{
+  template <typename Batch, typename ScalarKernel>
+  int closestScalar(const Ray& ray, const Batch& batch, float& tMax, ScalarKernel scalar)
+  {
+    int hit = -1;
+    for(size_t i = 0; i < batch.count; ++i)
+    {
+      float t = scalar(ray, batch, i);
+      if(t > 0.0f && t < tMax)
+      {
+        tMax = t;
+        hit = i;
+      }
+    }
+    return hit;
+  }
+
+  template <typename Batch, typename ScalarKernel>
+  bool occludedScalar(const Ray& ray, const Batch& batch, float maxT, ScalarKernel scalar)
+  {
+    for(size_t i = 0; i < batch.count; ++i)
+    {
+      float t = scalar(ray, batch, i);
+      if(t > 0.0f && (t < maxT || maxT < 0.0f)) return true;
+    }
+    return false;
+  }
+
+  int intersectSpheresScalar(const Ray& ray, const SphereBatch& batch, float& tMax) { return closestScalar(ray, batch, tMax, intersectSphereAt); }
+  int intersectRectanglesScalar(const Ray& ray, const RectangleBatch& batch, float& tMax) { return closestScalar(ray, batch, tMax, intersectRectangleAt); }
+  int intersectEllipsesScalar(const Ray& ray, const EllipseBatch& batch, float& tMax) { return closestScalar(ray, batch, tMax, intersectEllipseAt); }
+  bool occludedSpheresScalar(const Ray& ray, const SphereBatch& batch, float maxT) { return occludedScalar(ray, batch, maxT, intersectSphereAt); }
+  bool occludedRectanglesScalar(const Ray& ray, const RectangleBatch& batch, float maxT) { return occludedScalar(ray, batch, maxT, intersectRectangleAt); }
+  bool occludedEllipsesScalar(const Ray& ray, const EllipseBatch& batch, float maxT) { return occludedScalar(ray, batch, maxT, intersectEllipseAt); }
+
+  struct Kernels
+  {
+    SimdLevel level;
+    int (*intersectSpheres)(const Ray&, const SphereBatch&, float&);
+    int (*intersectRectangles)(const Ray&, const RectangleBatch&, float&);
+    int (*intersectEllipses)(const Ray&, const EllipseBatch&, float&);
+    bool (*occludedSpheres)(const Ray&, const SphereBatch&, float);
+    bool (*occludedRectangles)(const Ray&, const RectangleBatch&, float);
+    bool (*occludedEllipses)(const Ray&, const EllipseBatch&, float);
+  };
+
+  SimdLevel getSupportedLevel()
+  {
+#ifdef PATHTRACER_X86_SIMD
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2")) return SimdLevel::AVX2;
+    return SimdLevel::SSE;
+#else
+    return SimdLevel::Scalar;
+#endif
+  }
+
+  Kernels getKernels(SimdLevel level)
+  {
+    SimdLevel supported = getSupportedSimdLevel();
+    if((int)level > (int)supported) level = supported;
+
+    switch(level)
+    {
+#ifdef PATHTRACER_X86_SIMD
+    case SimdLevel::AVX2:
+      return {level, intersectSpheresAVX2, intersectRectanglesAVX2, intersectEllipsesAVX2,
+              occludedSpheresAVX2, occludedRectanglesAVX2, occludedEllipsesAVX2};
+    case SimdLevel::SSE:
+      return {level, intersectSpheresSSE, intersectRectanglesSSE, intersectEllipsesSSE,
+              occludedSpheresSSE, occludedRectanglesSSE, occludedEllipsesSSE};
+#endif
+    default:
+      return {SimdLevel::Scalar, intersectSpheresScalar, intersectRectanglesScalar, intersectEllipsesScalar,
+              occludedSpheresScalar, occludedRectanglesScalar, occludedEllipsesScalar};
+    }
+  }
+
+  Kernels& kernels()
+  {
+    static Kernels active = getKernels(SimdLevel::AVX2);
+    return active;
+  }
+}
+
+SimdLevel getSupportedSimdLevel()
+{
+  static const SimdLevel supported = getSupportedLevel();
+  return supported;
+}
+
+SimdLevel getActiveSimdLevel()
+{
+  return kernels().level;
+}
+
+void setSimdLevel(SimdLevel level)
+{
+  kernels() = getKernels(level);
+}
+
+const char* getSimdLevelName(SimdLevel level)
+{
+  switch(level)
+  {
+  case SimdLevel::AVX2: return "AVX2";
+  case SimdLevel::SSE: return "SSE";
+  default: return "scalar";
+  }
+}
+
+int intersectSpheres(const Ray& ray, const SphereBatch& batch, float& tMax)
+{
+  return kernels().intersectSpheres(ray, batch, tMax);
+}
+
+int intersectRectangles(const Ray& ray, const RectangleBatch& batch, float& tMax)
+{
+  return kernels().intersectRectangles(ray, batch, tMax);
+}
+
+int intersectEllipses(const Ray& ray, const EllipseBatch& batch, float& tMax)
+{
+  return kernels().intersectEllipses(ray, batch, tMax);
+}
+
+bool occludedSpheres(const Ray& ray, const SphereBatch& batch, float maxT)
+{
+  return kernels().occludedSpheres(ray, batch, maxT);
+}
+
+bool occludedRectangles(const Ray& ray, const RectangleBatch& batch, float maxT)
+{
+  return kernels().occludedRectangles(ray, batch, maxT);
+}
+
+bool occludedEllipses(const Ray& ray, const EllipseBatch& batch, float maxT)
+{
+  return kernels().occludedEllipses(ray, batch, maxT);
+}
@@ -0,0 +1,66 @@
+#include "simdKernels.hpp"
+
+#include <immintrin.h>
+
+namespace
+{
+  struct Float8
+  {
+    static const int WIDTH = 8;
+    __m256 v;
+
+    Float8() {}
+    Float8(__m256 x): v(x) {}
+    Float8(float x): v(_mm256_set1_ps(x)) {}
+
+    static Float8 load(const float* p) { return _mm256_loadu_ps(p); }
+    static Float8 indices() { return _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f); }
+    void store(float* p) const { _mm256_storeu_ps(p, v); }
+
+    Float8 operator+(const Float8& o) const { return _mm256_add_ps(v, o.v); }
+    Float8 operator-(const Float8& o) const { return _mm256_sub_ps(v, o.v); }
+    Float8 operator*(const Float8& o) const { return _mm256_mul_ps(v, o.v); }
+    Float8 operator/(const Float8& o) const { return _mm256_div_ps(v, o.v); }
+    Float8 operator-() const { return _mm256_xor_ps(v, _mm256_set1_ps(-0.0f)); }
+
+    Float8 operator<(const Float8& o) const { return _mm256_cmp_ps(v, o.v, _CMP_LT_OQ); }
+    Float8 operator>(const Float8& o) const { return _mm256_cmp_ps(v, o.v, _CMP_GT_OQ); }
+    Float8 operator&(const Float8& o) const { return _mm256_and_ps(v, o.v); }
+    Float8 operator|(const Float8& o) const { return _mm256_or_ps(v, o.v); }
+  };
+
+  inline Float8 sqrt(const Float8& a) { return _mm256_sqrt_ps(a.v); }
+  inline Float8 min(const Float8& a, const Float8& b) { return _mm256_min_ps(a.v, b.v); }
+  inline Float8 select(const Float8& mask, const Float8& a, const Float8& b) { return _mm256_blendv_ps(b.v, a.v, mask.v); }
+  inline int moveMask(const Float8& mask) { return _mm256_movemask_ps(mask.v); }
+}
+
+int intersectSpheresAVX2(const Ray& ray, const SphereBatch& batch, float& tMax)
+{
+  return closestLanes<Float8>(ray, batch, tMax, sphereLanes<Float8>, intersectSphereAt);
+}
+
+int intersectRectanglesAVX2(const Ray& ray, const RectangleBatch& batch, float& tMax)
+{
+  return closestLanes<Float8>(ray, batch, tMax, rectangleLanes<Float8>, intersectRectangleAt);
+}
+
+int intersectEllipsesAVX2(const Ray& ray, const EllipseBatch& batch, float& tMax)
+{
+  return closestLanes<Float8>(ray, batch, tMax, ellipseLanes<Float8>, intersectEllipseAt);
+}
+
+bool occludedSpheresAVX2(const Ray& ray, const SphereBatch& batch, float maxT)
+{
+  return occludedLanes<Float8>(ray, batch, maxT, sphereLanes<Float8>, intersectSphereAt);
+}
+
+bool occludedRectanglesAVX2(const Ray& ray, const RectangleBatch& batch, float maxT)
+{
+  return occludedLanes<Float8>(ray, batch, maxT, rectangleLanes<Float8>, intersectRectangleAt);
+}
+
+bool occludedEllipsesAVX2(const Ray& ray, const EllipseBatch& batch, float maxT)
+{
+  return occludedLanes<Float8>(ray, batch, maxT, ellipseLanes<Float8>, intersectEllipseAt);
+}
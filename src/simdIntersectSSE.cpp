@@ -0,0 +1,66 @@
+#include "simdKernels.hpp"
+
+#include <emmintrin.h>
+
+namespace
+{
+  struct Float4
+  {
+    static const int WIDTH = 4;
+    __m128 v;
+
+    Float4() {}
+    Float4(__m128 x): v(x) {}
+    Float4(float x): v(_mm_set1_ps(x)) {}
+
+    static Float4 load(const float* p) { return _mm_loadu_ps(p); }
+    static Float4 indices() { return _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f); }
+    void store(float* p) const { _mm_storeu_ps(p, v); }
+
+    Float4 operator+(const Float4& o) const { return _mm_add_ps(v, o.v); }
+    Float4 operator-(const Float4& o) const { return _mm_sub_ps(v, o.v); }
+    Float4 operator*(const Float4& o) const { return _mm_mul_ps(v, o.v); }
+    Float4 operator/(const Float4& o) const { return _mm_div_ps(v, o.v); }
+    Float4 operator-() const { return _mm_xor_ps(v, _mm_set1_ps(-0.0f)); }
+
+    Float4 operator<(const Float4& o) const { return _mm_cmplt_ps(v, o.v); }
+    Float4 operator>(const Float4& o) const { return _mm_cmpgt_ps(v, o.v); }
+    Float4 operator&(const Float4& o) const { return _mm_and_ps(v, o.v); }
+    Float4 operator|(const Float4& o) const { return _mm_or_ps(v, o.v); }
+  };
+
+  inline Float4 sqrt(const Float4& a) { return _mm_sqrt_ps(a.v); }
+  inline Float4 min(const Float4& a, const Float4& b) { return _mm_min_ps(a.v, b.v); }
+  inline Float4 select(const Float4& mask, const Float4& a, const Float4& b) { return _mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v)); }
+  inline int moveMask(const Float4& mask) { return _mm_movemask_ps(mask.v); }
+}
+
+int intersectSpheresSSE(const Ray& ray, const SphereBatch& batch, float& tMax)
+{
+  return closestLanes<Float4>(ray, batch, tMax, sphereLanes<Float4>, intersectSphereAt);
+}
+
+int intersectRectanglesSSE(const Ray& ray, const RectangleBatch& batch, float& tMax)
+{
+  return closestLanes<Float4>(ray, batch, tMax, rectangleLanes<Float4>, intersectRectangleAt);
+}
+
+int intersectEllipsesSSE(const Ray& ray, const EllipseBatch& batch, float& tMax)
+{
+  return closestLanes<Float4>(ray, batch, tMax, ellipseLanes<Float4>, intersectEllipseAt);
+}
+
+bool occludedSpheresSSE(const Ray& ray, const SphereBatch& batch, float maxT)
+{
+  return occludedLanes<Float4>(ray, batch, maxT, sphereLanes<Float4>, intersectSphereAt);
+}
+
+bool occludedRectanglesSSE(const Ray& ray, const RectangleBatch& batch, float maxT)
+{
+  return occludedLanes<Float4>(ray, batch, maxT, rectangleLanes<Float4>, intersectRectangleAt);
+}
+
+bool occludedEllipsesSSE(const Ray& ray, const EllipseBatch& batch, float maxT)
+{
+  return occludedLanes<Float4>(ray, batch, maxT, ellipseLanes<Float4>, intersectEllipseAt);
+}
@@ -1,6 +1,23 @@
 #include "sphere.hpp"
 
+#include <algorithm>
+
 #include "core.hpp"
+#include "aabb.hpp"
+#include "utils.hpp"
+
+namespace
+{
+  //Below this squared sine 1 - cos loses too much precision and is expanded instead
+  const float SMALL_CONE = 0.00068523f;
+
+  //1 - cos(thetaMax) of the cone of directions which hit the sphere
+  float coneSize(float sinThetaMaxSq)
+  {
+    if(sinThetaMaxSq < SMALL_CONE) return 0.5f * sinThetaMaxSq;
+    return 1.0f - sqrtf(1.0f - sinThetaMaxSq);
+  }
+}
 
 Sphere::Sphere(const Vector& c, const float radius): Object(), m_radius(radius), center(c)
 {
@@ -34,12 +51,18 @@ float Sphere::intersect(const Ray& ray) const
   return (t1 < t2 ? t1 : t2);
 }
 
-Vector Sphere::getNormalAt(const Vector& point) const
+AABB Sphere::getBoundingBox() const
+{
+  Vector extent(m_radius, m_radius, m_radius);
+  return AABB(center - extent, center + extent);
+}
+
+Vector Sphere::getNormalAt(const Vector& point, unsigned int) const
 {
   return (point - center) / m_radius;
 }
 
-void Sphere::getUVAt(const Vector& point, float& u, float& v) const
+void Sphere::getUVAt(const Vector& point, unsigned int, float& u, float& v) const
 {
   Vector rp = point - center;
   float theta = acos(std::max(-1.0f, std::min(1.0f, rp.y/m_radius)));
@@ -48,30 +71,52 @@ void Sphere::getUVAt(const Vector& point, float& u, float& v) const
   v = theta * M_1_PI;
 }
 
-Vector Sphere::getSample(RNG& rng) const
+SurfaceSample Sphere::getSample(float u1, float u2) const
 {
-  float cosT = 2.0f*rng.get() - 1.0f;
+  float cosT = 2.0f*u1 - 1.0f;
   float sinT = sqrtf(1.0f - cosT*cosT);
-  float phi = 2.0f * M_PI * rng.get();
-  return center + Vector(m_radius * sinT * cosf(phi), m_radius * cosT, m_radius * sinT * sinf(phi));
+  float phi = 2.0f * M_PI * u2;
+  return {center + Vector(m_radius * sinT * cosf(phi), m_radius * cosT, m_radius * sinT * sinf(phi)), 0};
 }
 
-void Sphere::getSamples(RNG& rng, int s1, int s2, Vector* samples) const
+//Uniform over the cone of directions in which the sphere is seen, so no sample lands on
+//the far side. From inside the sphere every direction hits it and area sampling is used.
+SurfaceSample Sphere::getSampleFrom(const Vector& ref, float u1, float u2, float& pdf) const
 {
-  float invS1 = 1.0f/s1;
-  float invS2 = 1.0f/s2;
-  float r1, r2, cosT, sinT, phi;
-  int i = 0;
-  for(int ny = 0; ny < s2; ++ny)
+  Vector toCenter = center - ref;
+  float distSq = toCenter.lengthSq();
+  float sinThetaMaxSq = m_radius * m_radius / distSq;
+  if(!(sinThetaMaxSq < 1.0f)) return Object::getSampleFrom(ref, u1, u2, pdf);
+
+  float cosTheta, sinThetaSq;
+  if(sinThetaMaxSq < SMALL_CONE)
+  {
+    sinThetaSq = sinThetaMaxSq * u1;
+    cosTheta = sqrtf(1.0f - sinThetaSq);
+  }
+  else
   {
-    for(int nx = 0; nx < s1; ++nx)
-    {
-      r1 = (nx + rng.get())*invS1;
-      r2 = (ny + rng.get())*invS2;
-      cosT = 2.0f*r1 - 1.0f;
-      sinT = sqrtf(1.0f - cosT*cosT);
-      phi = 2.0f * M_PI * r2;
-      samples[i++] = center + Vector(m_radius * sinT * cosf(phi), m_radius * cosT, m_radius * sinT * sinf(phi));
-    }
+    cosTheta = 1.0f - u1 * coneSize(sinThetaMaxSq);
+    sinThetaSq = 1.0f - cosTheta * cosTheta;
   }
-}
\ No newline at end of file
+
+  //Angle at the center between the direction to ref and the sampled point
+  float sinThetaMax = sqrtf(sinThetaMaxSq);
+  float cosAlpha = sinThetaSq / sinThetaMax + cosTheta * sqrtf(std::max(0.0f, 1.0f - sinThetaSq / sinThetaMaxSq));
+  float sinAlpha = sqrtf(std::max(0.0f, 1.0f - cosAlpha * cosAlpha));
+  float phi = 2.0f * M_PI * u2;
+
+  Vector w = toCenter / sqrtf(distSq), tangent, bitangent;
+  createOrthogonalSystem(w, tangent, bitangent);
+  Vector normal = (tangent * cosf(phi) + bitangent * sinf(phi)) * sinAlpha - w * cosAlpha;
+
+  pdf = 1.0f / (2.0f * M_PI * coneSize(sinThetaMaxSq));
+  return {center + normal * m_radius, 0};
+}
+
+float Sphere::getPDFFrom(const Vector& ref, const Vector& point, unsigned int primitive) const
+{
+  float sinThetaMaxSq = m_radius * m_radius / (center - ref).lengthSq();
+  if(!(sinThetaMaxSq < 1.0f)) return Object::getPDFFrom(ref, point, primitive);
+  return 1.0f / (2.0f * M_PI * coneSize(sinThetaMaxSq));
+}
@@ -0,0 +1,349 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "textureData.hpp"
+#include "vector.hpp"
+#include "utils.hpp"
+#include "imageFile.hpp"
+
+namespace
+{
+  //Texture coordinates are mostly within [0, 1), the division is only needed outside
+  int wrap(int i, int size)
+  {
+    if((unsigned int)i < (unsigned int)size) return i;
+    i %= size;
+    return i < 0 ? i + size : i;
+  }
+
+  //std::floor is a library call without SSE4.1
+  int floorToInt(float x)
+  {
+    int i = (int)x;
+    return x < i ? i - 1 : i;
+  }
+
+  //Source texels [first, first + count) an output texel of a box filter from size down to
+  //newSize covers, with their weights. Partially covered texels count in proportion.
+  struct Footprint
+  {
+    int first, count;
+    float weights[4];
+  };
+
+  std::vector<Footprint> boxFootprints(int size, int newSize)
+  {
+    std::vector<Footprint> footprints(newSize);
+    float scale = (float)size / newSize;
+    for(int i = 0; i < newSize; ++i)
+    {
+      float start = i * scale, end = (i + 1) * scale;
+      Footprint& f = footprints[i];
+      f.first = (int)start;
+      f.count = 0;
+      for(int s = f.first; s < size && s < end && f.count < 4; ++s)
+        f.weights[f.count++] = (std::min(end, s + 1.0f) - std::max(start, (float)s)) / scale;
+    }
+    return footprints;
+  }
+
+  //Linear values of the 8-bit sRGB codes, and the midpoints between neighbouring ones
+  //for encoding linear values back to the nearest code. The codes are found through
+  //buckets narrower than the smallest gap between midpoints, so at most one midpoint
+  //separates the code at the start of a bucket from the right one.
+  struct SRGBTable
+  {
+    static const int BUCKETS = 4096;
+    float linear[256];
+    float midpoints[256];
+    uint8_t buckets[BUCKETS];
+
+    SRGBTable()
+    {
+      for(int i = 0; i < 256; ++i)
+      {
+        linear[i] = i / 255.0f;
+        sRGBDecode(linear[i]);
+      }
+      for(int i = 0; i < 255; ++i)
+        midpoints[i] = 0.5f * (linear[i] + linear[i + 1]);
+      midpoints[255] = 2.0f;
+      for(int i = 0; i < BUCKETS; ++i)
+        buckets[i] = std::upper_bound(midpoints, midpoints + 255, (float)i / (BUCKETS - 1)) - midpoints;
+    }
+  };
+  const SRGBTable SRGB;
+
+  uint8_t encodeSRGB(float c)
+  {
+    if(!(c > 0.0f)) return 0;
+    if(c >= 1.0f) return 255;
+    int code = SRGB.buckets[(int)(c * (SRGBTable::BUCKETS - 1))];
+    return c >= SRGB.midpoints[code] ? code + 1 : code;
+  }
+
+  //Round to nearest even conversions by Fabian Giesen. Values too large for a half
+  //are clamped to the largest one instead of becoming infinite.
+  uint16_t floatToHalf(float value)
+  {
+    uint32_t f;
+    std::memcpy(&f, &value, sizeof(f));
+    uint32_t sign = f & 0x80000000u;
+    f ^= sign;
+
+    uint16_t h;
+    if(f >= 0x477ff000u)
+    {
+      h = f > 0x7f800000u ? 0x7e00 : 0x7bff;
+    }
+    else if(f < 0x38800000u)
+    {
+      //Subnormal, the addition rounds the mantissa into place
+      float denormal;
+      std::memcpy(&denormal, &f, sizeof(f));
+      denormal += 0.5f;
+      std::memcpy(&f, &denormal, sizeof(f));
+      h = f - 0x3f000000u;
+    }
+    else
+    {
+      uint32_t odd = (f >> 13) & 1;
+      f += 0xc8000fffu + odd;
+      h = f >> 13;
+    }
+    return h | (sign >> 16);
+  }
+
+  float halfToFloat(uint16_t h)
+  {
+    //Scaling by 2^112 moves the exponent to the float bias, subnormals included
+    uint32_t f = (uint32_t)(h & 0x7fff) << 13;
+    float result;
+    std::memcpy(&result, &f, sizeof(f));
+    result *= 5.192296858534828e+33f;
+    std::memcpy(&f, &result, sizeof(f));
+    if(result >= 65536.0f) f |= 0x7f800000u;
+    f |= (uint32_t)(h & 0x8000) << 16;
+    std::memcpy(&result, &f, sizeof(f));
+    return result;
+  }
+
+  //Decoding every half through a table is faster than converting it, even when the texels
+  //are in the cache
+  struct HalfTable
+  {
+    float linear[65536];
+
+    HalfTable()
+    {
+      for(int i = 0; i < 65536; ++i)
+        linear[i] = halfToFloat(i);
+    }
+  };
+  const HalfTable HALF;
+
+  float toLinear(uint8_t c) { return SRGB.linear[c]; }
+  float toLinear(uint16_t c) { return HALF.linear[c]; }
+  float toLinear(float c) { return c; }
+
+  //Box filters row-major RGB data to a smaller size in linear RGB
+  template<typename T>
+  std::vector<float> downsample(const T* src, int width, int height, int newWidth, int newHeight)
+  {
+    std::vector<Footprint> fx = boxFootprints(width, newWidth), fy = boxFootprints(height, newHeight);
+    std::vector<float> rows(3 * newWidth * height), dst(3 * newWidth * newHeight, 0.0f);
+    for(int y = 0; y < height; ++y)
+    {
+      for(int x = 0; x < newWidth; ++x)
+      {
+        const Footprint& f = fx[x];
+        for(int c = 0; c < 3; ++c)
+        {
+          float sum = 0.0f;
+          for(int k = 0; k < f.count; ++k)
+            sum += f.weights[k] * toLinear(src[3 * (y * width + f.first + k) + c]);
+          rows[3 * (y * newWidth + x) + c] = sum;
+        }
+      }
+    }
+
+    for(int y = 0; y < newHeight; ++y)
+    {
+      const Footprint& f = fy[y];
+      for(int k = 0; k < f.count; ++k)
+      {
+        const float* row = &rows[3 * (f.first + k) * newWidth];
+        float* out = &dst[3 * y * newWidth];
+        for(int i = 0; i < 3 * newWidth; ++i)
+          out[i] += f.weights[k] * row[i];
+      }
+    }
+    return dst;
+  }
+}
+
+TextureData::TextureData(int width, int height, const float *data): m_width(width), m_height(height), m_format(Format::Half)
+{
+  build(data);
+}
+
+TextureData::TextureData(int width, int height, const uint8_t *srgb): m_width(width), m_height(height), m_format(Format::SRGB8)
+{
+  build(srgb);
+}
+
+TextureData::TextureData(const Vector& color): m_width(1), m_height(1), m_format(Format::Half)
+{
+  float data[3] = {color.x, color.y, color.z};
+  build(data);
+}
+
+std::shared_ptr<const TextureData> TextureData::load(const char* fileName)
+{
+  ImageFile image(fileName);
+  if(!image.isValid()) return nullptr;
+
+  //8-bit images are tiled straight from the mapped file
+  if(const uint8_t* srgb = image.getSRGB())
+    return std::make_shared<const TextureData>(image.getWidth(), image.getHeight(), srgb);
+  std::vector<float> data = image.getLinear();
+  return std::make_shared<const TextureData>(image.getWidth(), image.getHeight(), data.data());
+}
+
+size_t TextureData::layout()
+{
+  m_levels.clear();
+  int width = m_width, height = m_height;
+  size_t offset = 0;
+  for(;;)
+  {
+    Level l;
+    l.width = width;
+    l.height = height;
+    l.tilesX = (width + TILE_SIZE - 1) >> TILE_SHIFT;
+    l.offset = offset;
+    int tilesY = (height + TILE_SIZE - 1) >> TILE_SHIFT;
+    offset += 3 * l.tilesX * tilesY * TILE_SIZE * TILE_SIZE;
+    m_levels.push_back(l);
+
+    if(width == 1 && height == 1) break;
+    width = std::max(1, width / 2);
+    height = std::max(1, height / 2);
+  }
+  return offset;
+}
+
+template<typename T>
+void TextureData::storeMips(const T* data)
+{
+  std::vector<float> level;
+  for(size_t i = 1; i < m_levels.size(); ++i)
+  {
+    const Level& l = m_levels[i];
+    const Level& previous = m_levels[i - 1];
+    level = i == 1 ? downsample(data, previous.width, previous.height, l.width, l.height) :
+                     downsample(level.data(), previous.width, previous.height, l.width, l.height);
+    store(l, level.data());
+  }
+}
+
+void TextureData::build(const float* data)
+{
+  m_half.assign(layout(), 0);
+  store(m_levels[0], data);
+  storeMips(data);
+}
+
+void TextureData::build(const uint8_t* srgb)
+{
+  m_srgb.assign(layout(), 0);
+
+  //The full resolution level keeps the texels as they are, copied a tile row at a time
+  const Level& first = m_levels[0];
+  for(int y = 0; y < m_height; ++y)
+  {
+    for(int x = 0; x < m_width; x += TILE_SIZE)
+    {
+      int count = m_width - x < TILE_SIZE ? m_width - x : TILE_SIZE;
+      std::memcpy(&m_srgb[getTexelIndex(first, x, y)], srgb + 3 * (y * m_width + x), 3 * count);
+    }
+  }
+  storeMips(srgb);
+}
+
+void TextureData::store(const Level& level, const float* data)
+{
+  for(int y = 0; y < level.height; ++y)
+  {
+    for(int x = 0; x < level.width; ++x)
+    {
+      size_t texel = getTexelIndex(level, x, y);
+      const float* rgb = data + 3 * (y * level.width + x);
+      for(int c = 0; c < 3; ++c)
+      {
+        if(m_format == Format::SRGB8) m_srgb[texel + c] = encodeSRGB(rgb[c]);
+        else m_half[texel + c] = floatToHalf(rgb[c]);
+      }
+    }
+  }
+}
+
+template<typename T>
+Vector TextureData::nearest(const T* texels, const Level& level, float u, float v) const
+{
+  const T* texel = texels + getTexelIndex(level, wrap(floorToInt(u*level.width), level.width), wrap(floorToInt(v*level.height), level.height));
+  return Vector(toLinear(texel[0]), toLinear(texel[1]), toLinear(texel[2]));
+}
+
+Vector TextureData::sample(float u, float v) const
+{
+  if(m_format == Format::SRGB8) return nearest(m_srgb.data(), m_levels[0], u, v);
+  return nearest(m_half.data(), m_levels[0], u, v);
+}
+
+template<typename T>
+Vector TextureData::bilinear(const T* texels, const Level& level, float u, float v) const
+{
+  float x = u * level.width - 0.5f, y = v * level.height - 0.5f;
+  int ix = floorToInt(x), iy = floorToInt(y);
+  float tx = x - ix, ty = y - iy;
+  int x0 = wrap(ix, level.width), y0 = wrap(iy, level.height);
+  int x1 = x0 + 1 < level.width ? x0 + 1 : 0, y1 = y0 + 1 < level.height ? y0 + 1 : 0;
+
+  const T* t00 = texels + getTexelIndex(level, x0, y0);
+  const T* t10 = texels + getTexelIndex(level, x1, y0);
+  const T* t01 = texels + getTexelIndex(level, x0, y1);
+  const T* t11 = texels + getTexelIndex(level, x1, y1);
+  float w00 = (1.0f - tx) * (1.0f - ty), w10 = tx * (1.0f - ty), w01 = (1.0f - tx) * ty, w11 = tx * ty;
+  float rgb[3];
+  for(int c = 0; c < 3; ++c)
+    rgb[c] = w00 * toLinear(t00[c]) + w10 * toLinear(t10[c]) + w01 * toLinear(t01[c]) + w11 * toLinear(t11[c]);
+  return Vector(rgb[0], rgb[1], rgb[2]);
+}
+
+Vector TextureData::bilinear(const Level& level, float u, float v) const
+{
+  if(m_format == Format::SRGB8) return bilinear(m_srgb.data(), level, u, v);
+  return bilinear(m_half.data(), level, u, v);
+}
+
+Vector TextureData::sampleBilinear(float u, float v, int level) const
+{
+  level = std::min(std::max(level, 0), (int)m_levels.size() - 1);
+  return bilinear(m_levels[level], u, v);
+}
+
+Vector TextureData::sampleTrilinear(float u, float v, float footprint) const
+{
+  //Level at which the footprint covers one texel
+  float texels = footprint * std::max(m_width, m_height);
+  if(!(texels > 1.0f)) return bilinear(m_levels[0], u, v);
+  float lod = std::log2(texels);
+  int last = m_levels.size() - 1;
+  if(lod >= last) return bilinear(m_levels[last], u, v);
+
+  int level = (int)lod;
+  float t = lod - level;
+  return bilinear(m_levels[level], u, v) * (1.0f - t) + bilinear(m_levels[level + 1], u, v) * t;
+}
@@ -0,0 +1,38 @@
+#include <iostream>
+
+#include "textureRegistry.hpp"
+#include "textureData.hpp"
+
+Texture TextureRegistry::get(const std::string& fileName, bool flip_v)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  auto it = m_textures.find(fileName);
+  if(it == m_textures.end())
+  {
+    it = m_textures.emplace(fileName, TextureData::load(fileName.c_str())).first;
+    if(!it->second)
+      std::cout << "ERROR: Texture (" << fileName << ") could not be loaded!\n";
+  }
+  return Texture(it->second, flip_v);
+}
+
+size_t TextureRegistry::size() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_textures.size();
+}
+
+size_t TextureRegistry::getMemorySize() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  size_t bytes = 0;
+  for(const auto& texture : m_textures)
+    if(texture.second) bytes += texture.second->getMemorySize();
+  return bytes;
+}
+
+void TextureRegistry::clear()
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_textures.clear();
+}
@@ -44,7 +44,7 @@ TexturedMaterial::~TexturedMaterial()
 float TexturedMaterial::getEmittanceIntensity() const { return m_emittanceIntensity; }
 void TexturedMaterial::setEmittanceIntensity(float emitIntensity) { m_emittanceIntensity = std::max(emitIntensity, 0.0f); m_emissive = m_emittanceIntensity > 0.1; }
 
-Vector TexturedMaterial::getColor(float u, float v) const { return texture.sample(u, v); }
+Vector TexturedMaterial::getColor(float u, float v, float footprint) const { return texture.sampleTrilinear(u, v, footprint); }
 Vector TexturedMaterial::getEmittance(float u, float v) const { return m_emittanceIntensity*emittance.sample(u, v); }
 bool TexturedMaterial::isEmissive() const { return m_emissive; }
 BRDF* TexturedMaterial::getBRDF() const { return brdf; }
\ No newline at end of file
@@ -0,0 +1,68 @@
+#include "tileScheduler.hpp"
+
+#include <algorithm>
+#include <thread>
+
+TileScheduler::TileScheduler(unsigned int width, unsigned int height, unsigned int tileSize, unsigned int workers)
+{
+  if(tileSize == 0) tileSize = 1;
+  if(workers == 0) workers = 1;
+
+  std::vector<Tile> tiles;
+  for(unsigned int y = 0; y < height; y += tileSize)
+  {
+    for(unsigned int x = 0; x < width; x += tileSize)
+    {
+      tiles.push_back({x, y, std::min(x + tileSize, width), std::min(y + tileSize, height)});
+    }
+  }
+  m_tileCount = tiles.size();
+
+  //Contiguous runs of tiles keep each worker inside one region of the image
+  //until it has to start stealing
+  for(unsigned int w = 0; w < workers; ++w)
+  {
+    m_queues.emplace_back(new WorkQueue());
+    size_t begin = m_tileCount * w / workers;
+    size_t end = m_tileCount * (w + 1) / workers;
+    m_queues[w]->tiles.assign(tiles.begin() + begin, tiles.begin() + end);
+  }
+}
+
+bool TileScheduler::pop(unsigned int worker, Tile& tile)
+{
+  WorkQueue& queue = *m_queues[worker];
+  std::lock_guard<std::mutex> lock(queue.mutex);
+  if(queue.tiles.empty()) return false;
+  tile = queue.tiles.front();
+  queue.tiles.pop_front();
+  return true;
+}
+
+bool TileScheduler::steal(unsigned int victim, Tile& tile)
+{
+  WorkQueue& queue = *m_queues[victim];
+  std::lock_guard<std::mutex> lock(queue.mutex);
+  if(queue.tiles.empty()) return false;
+  tile = queue.tiles.back();
+  queue.tiles.pop_back();
+  return true;
+}
+
+bool TileScheduler::next(unsigned int worker, Tile& tile)
+{
+  if(pop(worker, tile)) return true;
+
+  unsigned int workers = m_queues.size();
+  for(unsigned int i = 1; i < workers; ++i)
+  {
+    if(steal((worker + i) % workers, tile)) return true;
+  }
+  return false;
+}
+
+unsigned int TileScheduler::getDefaultThreadCount()
+{
+  unsigned int threads = std::thread::hardware_concurrency();
+  return threads > 0 ? threads : 1;
+}
@@ -0,0 +1,121 @@
+#include "transform.hpp"
+
+#include <cmath>
+
+Transform::Transform(): m_offset(0, 0, 0)
+{
+  for(int i = 0; i < 3; ++i)
+  {
+    for(int j = 0; j < 3; ++j)
+      m_matrix[i][j] = i == j ? 1.0f : 0.0f;
+  }
+}
+
+Transform::Transform(const Vector& row0, const Vector& row1, const Vector& row2, const Vector& offset): m_offset(offset)
+{
+  const Vector* rows[3] = {&row0, &row1, &row2};
+  for(int i = 0; i < 3; ++i)
+  {
+    for(int j = 0; j < 3; ++j)
+      m_matrix[i][j] = (*rows[i])[j];
+  }
+}
+
+Transform Transform::translation(const Vector& offset)
+{
+  return Transform(Vector(1, 0, 0), Vector(0, 1, 0), Vector(0, 0, 1), offset);
+}
+
+Transform Transform::scaling(const Vector& factors)
+{
+  return Transform(Vector(factors.x, 0, 0), Vector(0, factors.y, 0), Vector(0, 0, factors.z), Vector(0, 0, 0));
+}
+
+Transform Transform::rotation(const Vector& axis, float degrees)
+{
+  //Rodrigues' rotation formula
+  Vector a = axis;
+  a.normalize();
+  float angle = degrees * M_PI / 180.0f;
+  float c = std::cos(angle), s = std::sin(angle), t = 1.0f - c;
+  return Transform(
+    Vector(t*a.x*a.x + c, t*a.x*a.y - s*a.z, t*a.x*a.z + s*a.y),
+    Vector(t*a.x*a.y + s*a.z, t*a.y*a.y + c, t*a.y*a.z - s*a.x),
+    Vector(t*a.x*a.z - s*a.y, t*a.y*a.z + s*a.x, t*a.z*a.z + c),
+    Vector(0, 0, 0));
+}
+
+Transform Transform::operator*(const Transform& other) const
+{
+  Transform result;
+  for(int i = 0; i < 3; ++i)
+  {
+    for(int j = 0; j < 3; ++j)
+      result.m_matrix[i][j] = m_matrix[i][0] * other.m_matrix[0][j] + m_matrix[i][1] * other.m_matrix[1][j] + m_matrix[i][2] * other.m_matrix[2][j];
+  }
+  result.m_offset = applyToPoint(other.m_offset);
+  return result;
+}
+
+float Transform::getDeterminant() const
+{
+  const float (*m)[3] = m_matrix;
+  return m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1]) -
+         m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0]) +
+         m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]);
+}
+
+Transform Transform::inverse() const
+{
+  float det = getDeterminant();
+  if(std::fabs(det) < 1e-12f) return Transform();
+
+  //Adjugate divided by the determinant
+  const float (*m)[3] = m_matrix;
+  float f = 1.0f / det;
+  Transform result;
+  result.m_matrix[0][0] = (m[1][1] * m[2][2] - m[1][2] * m[2][1]) * f;
+  result.m_matrix[0][1] = (m[0][2] * m[2][1] - m[0][1] * m[2][2]) * f;
+  result.m_matrix[0][2] = (m[0][1] * m[1][2] - m[0][2] * m[1][1]) * f;
+  result.m_matrix[1][0] = (m[1][2] * m[2][0] - m[1][0] * m[2][2]) * f;
+  result.m_matrix[1][1] = (m[0][0] * m[2][2] - m[0][2] * m[2][0]) * f;
+  result.m_matrix[1][2] = (m[0][2] * m[1][0] - m[0][0] * m[1][2]) * f;
+  result.m_matrix[2][0] = (m[1][0] * m[2][1] - m[1][1] * m[2][0]) * f;
+  result.m_matrix[2][1] = (m[0][1] * m[2][0] - m[0][0] * m[2][1]) * f;
+  result.m_matrix[2][2] = (m[0][0] * m[1][1] - m[0][1] * m[1][0]) * f;
+  result.m_offset = -result.applyToVector(m_offset);
+  return result;
+}
+
+Vector Transform::applyToPoint(const Vector& point) const
+{
+  return applyToVector(point) + m_offset;
+}
+
+Vector Transform::applyToVector(const Vector& v) const
+{
+  const float (*m)[3] = m_matrix;
+  return Vector(m[0][0] * v.x + m[0][1] * v.y + m[0][2] * v.z,
+                m[1][0] * v.x + m[1][1] * v.y + m[1][2] * v.z,
+                m[2][0] * v.x + m[2][1] * v.y + m[2][2] * v.z);
+}
+
+Vector Transform::applyToNormal(const Vector& n) const
+{
+  const float (*m)[3] = m_matrix;
+  return Vector(m[0][0] * n.x + m[1][0] * n.y + m[2][0] * n.z,
+                m[0][1] * n.x + m[1][1] * n.y + m[2][1] * n.z,
+                m[0][2] * n.x + m[1][2] * n.y + m[2][2] * n.z);
+}
+
+AABB Transform::applyToBox(const AABB& box) const
+{
+  AABB result;
+  if(box.isEmpty()) return result;
+  for(int corner = 0; corner < 8; ++corner)
+  {
+    Vector point(corner & 1 ? box.max.x : box.min.x, corner & 2 ? box.max.y : box.min.y, corner & 4 ? box.max.z : box.min.z);
+    result.extend(applyToPoint(point));
+  }
+  return result;
+}
@@ -0,0 +1,241 @@
+#include "triangleMesh.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <utility>
+
+#include "core.hpp"
+#include "objLoader.hpp"
+
+TriangleMesh::TriangleMesh(MeshData data): Object(), m_data(std::move(data))
+{
+  init();
+}
+
+TriangleMesh::TriangleMesh(const MeshView& view, std::shared_ptr<const void> owner, std::shared_ptr<BaseMaterial> mat): Object(mat), m_owner(std::move(owner))
+{
+  initView(view);
+}
+
+TriangleMesh::TriangleMesh(MeshData data, std::shared_ptr<BaseMaterial> mat): Object(mat), m_data(std::move(data))
+{
+  init();
+}
+
+TriangleMesh::TriangleMesh(const char* fileName): Object()
+{
+  if(!loadOBJ(fileName, m_data))
+    std::cout << "ERROR: Mesh (" << fileName << ") could not be loaded!\n";
+  init();
+}
+
+TriangleMesh::TriangleMesh(const char* fileName, std::shared_ptr<BaseMaterial> mat): Object(mat)
+{
+  if(!loadOBJ(fileName, m_data))
+    std::cout << "ERROR: Mesh (" << fileName << ") could not be loaded!\n";
+  init();
+}
+
+void TriangleMesh::init()
+{
+  size_t triangles = m_data.indices.size() / 3;
+  m_data.indices.resize(3 * triangles);
+  m_valid = triangles > 0;
+
+  std::vector<AABB> bounds(triangles);
+  for(size_t i = 0; i < triangles; ++i)
+  {
+    for(int k = 0; k < 3; ++k)
+      bounds[i].extend(m_data.positions[m_data.indices[3*i + k]]);
+    bounds[i].pad(0.00001f);
+  }
+  m_bvh.build(bounds);
+
+  //Store triangles in leaf order, so every leaf reads a contiguous block of indices
+  const std::vector<unsigned int>& order = m_bvh.getIndices();
+  std::vector<unsigned int> indices(m_data.indices.size());
+  for(size_t i = 0; i < triangles; ++i)
+  {
+    for(int k = 0; k < 3; ++k)
+      indices[3*i + k] = m_data.indices[3*order[i] + k];
+  }
+  m_data.indices.swap(indices);
+
+  m_areaCDF.resize(triangles);
+  float area = 0.0f;
+  for(size_t i = 0; i < triangles; ++i)
+  {
+    const Vector& p0 = m_data.positions[m_data.indices[3*i]];
+    const Vector& p1 = m_data.positions[m_data.indices[3*i + 1]];
+    const Vector& p2 = m_data.positions[m_data.indices[3*i + 2]];
+    area += 0.5f * (p1 - p0).cross(p2 - p0).length();
+    m_areaCDF[i] = area;
+  }
+  m_invPDF = area;
+
+  m_view.positions = m_data.positions.data();
+  m_view.normals = m_data.normals.empty() ? nullptr : m_data.normals.data();
+  m_view.uvs = m_data.uvs.empty() ? nullptr : m_data.uvs.data();
+  m_view.indices = m_data.indices.data();
+  m_view.areaCDF = m_areaCDF.data();
+  m_view.vertexCount = m_data.positions.size();
+  m_view.triangleCount = triangles;
+  m_view.nodes = m_bvh.getNodes();
+  m_view.nodeCount = m_bvh.getNodeCount();
+}
+
+void TriangleMesh::initView(const MeshView& view)
+{
+  m_view = view;
+  m_valid = view.triangleCount > 0 && m_bvh.adopt(view.nodes, view.nodeCount, view.triangleCount);
+  if(!m_valid) m_view.triangleCount = 0;
+  m_invPDF = m_valid ? view.areaCDF[view.triangleCount - 1] : 0.0f;
+}
+
+bool TriangleMesh::isValidView(const MeshView& view)
+{
+  if(!view.positions || !view.indices || !view.areaCDF || !view.nodes) return false;
+  for(size_t i = 0; i < 3 * view.triangleCount; ++i)
+  {
+    if(view.indices[i] >= view.vertexCount) return false;
+  }
+  BVH bvh;
+  return bvh.adopt(view.nodes, view.nodeCount, view.triangleCount);
+}
+
+//Moller-Trumbore, both sides of a triangle are hit
+inline float TriangleMesh::intersectTriangle(const Ray& ray, unsigned int triangle) const
+{
+  const unsigned int* tri = &m_view.indices[3*triangle];
+  const Vector& p0 = m_view.positions[tri[0]];
+  Vector e1 = m_view.positions[tri[1]] - p0;
+  Vector e2 = m_view.positions[tri[2]] - p0;
+
+  Vector pvec = ray.direction.cross(e2);
+  float det = e1.dot(pvec);
+  if(det > -1e-12f && det < 1e-12f) return -1;
+  float invDet = 1.0f / det;
+
+  Vector tvec = ray.origin - p0;
+  float b1 = tvec.dot(pvec) * invDet;
+  if(b1 < 0.0f || b1 > 1.0f) return -1;
+
+  Vector qvec = tvec.cross(e1);
+  float b2 = ray.direction.dot(qvec) * invDet;
+  if(b2 < 0.0f || b1 + b2 > 1.0f) return -1;
+
+  return e2.dot(qvec) * invDet;
+}
+
+float TriangleMesh::intersect(const Ray& ray) const
+{
+  unsigned int primitive;
+  return intersectPrimitive(ray, primitive);
+}
+
+float TriangleMesh::intersectPrimitive(const Ray& ray, unsigned int& primitive) const
+{
+  float closestT = std::numeric_limits<float>::max();
+  primitive = 0;
+  bool hit = m_bvh.intersect(ray, closestT, [&](unsigned int i, float& tMax)
+  {
+    float t = intersectTriangle(ray, i);
+    if(t > 0.0f && t < tMax)
+    {
+      tMax = t;
+      primitive = i;
+      return true;
+    }
+    return false;
+  });
+  return hit ? closestT : -1;
+}
+
+bool TriangleMesh::occludes(const Ray& ray, float maxT) const
+{
+  return m_bvh.occluded(ray, maxT, [&](unsigned int i)
+  {
+    float t = intersectTriangle(ray, i);
+    return t > 0.0f && (t < maxT || maxT < 0.0f);
+  });
+}
+
+void TriangleMesh::getBarycentrics(const Vector& point, unsigned int triangle, float& b1, float& b2) const
+{
+  const unsigned int* tri = &m_view.indices[3*triangle];
+  const Vector& p0 = m_view.positions[tri[0]];
+  Vector e1 = m_view.positions[tri[1]] - p0;
+  Vector e2 = m_view.positions[tri[2]] - p0;
+  Vector rel = point - p0;
+
+  float d00 = e1.dot(e1);
+  float d01 = e1.dot(e2);
+  float d11 = e2.dot(e2);
+  float d20 = rel.dot(e1);
+  float d21 = rel.dot(e2);
+  float denom = d00 * d11 - d01 * d01;
+  if(denom == 0.0f)
+  {
+    b1 = b2 = 0.0f;
+    return;
+  }
+  b1 = (d11 * d20 - d01 * d21) / denom;
+  b2 = (d00 * d21 - d01 * d20) / denom;
+}
+
+Vector TriangleMesh::getNormalAt(const Vector& point, unsigned int primitive) const
+{
+  const unsigned int* tri = &m_view.indices[3*primitive];
+  if(!m_view.normals)
+  {
+    const Vector& p0 = m_view.positions[tri[0]];
+    return (m_view.positions[tri[1]] - p0).cross(m_view.positions[tri[2]] - p0).normalize();
+  }
+
+  float b1, b2;
+  getBarycentrics(point, primitive, b1, b2);
+  Vector normal = m_view.normals[tri[0]] * (1.0f - b1 - b2) + m_view.normals[tri[1]] * b1 + m_view.normals[tri[2]] * b2;
+  return normal.normalize();
+}
+
+void TriangleMesh::getUVAt(const Vector& point, unsigned int primitive, float& u, float& v) const
+{
+  float b1, b2;
+  getBarycentrics(point, primitive, b1, b2);
+  if(!m_view.uvs)
+  {
+    u = b1;
+    v = b2;
+    return;
+  }
+
+  const unsigned int* tri = &m_view.indices[3*primitive];
+  float b0 = 1.0f - b1 - b2;
+  u = b0 * m_view.uvs[2*tri[0]] + b1 * m_view.uvs[2*tri[1]] + b2 * m_view.uvs[2*tri[2]];
+  v = b0 * m_view.uvs[2*tri[0] + 1] + b1 * m_view.uvs[2*tri[1] + 1] + b2 * m_view.uvs[2*tri[2] + 1];
+}
+
+AABB TriangleMesh::getBoundingBox() const
+{
+  return m_bvh.getBounds();
+}
+
+SurfaceSample TriangleMesh::getSample(float r1, float r2) const
+{
+  if(!m_valid) return {Vector(0,0,0), 0};
+
+  //r1 picks a triangle proportionally to its area and is then reused inside it
+  const float* areaCDF = m_view.areaCDF;
+  size_t triangles = m_view.triangleCount;
+  float target = r1 * m_invPDF;
+  size_t triangle = std::upper_bound(areaCDF, areaCDF + triangles, target) - areaCDF;
+  triangle = std::min(triangle, triangles - 1);
+  float start = triangle > 0 ? areaCDF[triangle - 1] : 0.0f;
+  float area = areaCDF[triangle] - start;
+  r1 = area > 0.0f ? std::min((target - start) / area, 1.0f) : 0.0f;
+
+  const unsigned int* tri = &m_view.indices[3*triangle];
+  float su = sqrtf(r1);
+  Vector point = m_view.positions[tri[0]] * (1.0f - su) + m_view.positions[tri[1]] * (su * (1.0f - r2)) + m_view.positions[tri[2]] * (su * r2);
+  return {point, (unsigned int)triangle};
+}
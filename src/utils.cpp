@@ -2,35 +2,22 @@
 
 #include <fstream>
 #include <cmath>
+#include <cstring>
 
 #include "vector.hpp"
+#include "imageFile.hpp"
 
 bool loadPPM(const char *fileName, int &width, int &height, char*& pixels)
 {
-  std::ifstream file;
-  file.open(fileName, std::ios::binary);
-  if(!file.is_open()) return false;
-
-  char *h = new char[3];
-  file.read(h, 3);
-  if(h[0] != 'P' || h[1] != '6') return false;
-  delete[] h;
-
-  while(file.get() == '#')
-  {
-    while(file.get() != '\n');
-  }
-  file.unget();
-
-  int max;
-  file >> width >> height >> max;
-  file.get();
+  ImageFile image(fileName);
+  const uint8_t* srgb = image.getSRGB();
+  if(!srgb) return false;
 
+  width = image.getWidth();
+  height = image.getHeight();
   int len = 3*width*height;
   pixels = new char[len];
-  file.read(pixels, len);
-
-  file.close();
+  std::memcpy(pixels, srgb, len);
   return true;
 }
 
@@ -90,7 +77,7 @@ Vector toXYZ(const Vector& color)
   Vector result;
   result.x = 0.4123865632529917*color.x + 0.35759149092062537*color.y + 0.18045049120356368*color.z;
   result.y = 0.21263682167732384*color.x + 0.7151829818412507*color.y + 0.07218019648142547*color.z;
-  result.z = 0.019330620152483987*color.z + 0.11919716364020845*color.y + 0.9503725870054354*color.z;
+  result.z = 0.019330620152483987*color.x + 0.11919716364020845*color.y + 0.9503725870054354*color.z;
 
   return result;
 }
@@ -100,7 +87,7 @@ Vector fromXYZ(const Vector& color)
   Vector result;
   result.x = 3.2410032329763587*color.x - 1.5373989694887855*color.y - 0.4986158819963629*color.z;
   result.y = -0.9692242522025166*color.x + 1.875929983695176*color.y + 0.041554226340084724*color.z;
-  result.z = 0.055639419851975444*color.z - 0.20401120612390997*color.y + 1.0571489771875335*color.z;
+  result.z = 0.055639419851975444*color.x - 0.20401120612390997*color.y + 1.0571489771875335*color.z;
 
   return result;
 }
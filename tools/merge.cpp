@@ -0,0 +1,57 @@
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "utils.hpp"
+#include "film.hpp"
+#include "postProcess.hpp"
+#include "renderJob.hpp"
+
+//PathTracerMerge [--hdr output.pfm] output.ppm partial... -- adds up the partial films saved
+//by the jobs of a distributed render (PathTracer --job or --worker) and tone maps the image
+//into a PPM. Every pixel gets the mean of all its samples, whichever partials they are in.
+int main(int argc, char** argv)
+{
+  int arg = 1;
+  const char* hdrOutput = nullptr;
+  if(argc > arg + 1 && std::strcmp(argv[arg], "--hdr") == 0)
+  {
+    hdrOutput = argv[arg + 1];
+    arg += 2;
+  }
+  if(argc < arg + 2)
+  {
+    std::cout << "Usage: " << argv[0] << " [--hdr output.pfm] output.ppm partial...\n";
+    return 1;
+  }
+  const char* output = argv[arg];
+  std::vector<std::string> partials(argv + arg + 1, argv + argc);
+
+  Film film;
+  if(!mergePartials(partials, film)) return 1;
+  if(film.getMinSampleCount() == 0)
+    std::cout << "Some pixels have no samples, a job is missing\n";
+
+  if(hdrOutput && !film.savePFM(hdrOutput))
+  {
+    std::cout << "ERROR: HDR image (" << hdrOutput << ") could not be saved!\n";
+    return 1;
+  }
+
+  PostProcess post;
+  post.addOperator(std::make_shared<ReinhardOperator>());
+  std::vector<Vector> image;
+  post.resolve(film, image);
+  post.apply(image);
+
+  std::vector<char> pixels(3 * image.size());
+  post.encodeSRGB(image, pixels.data());
+  if(!savePPM(output, film.getWidth(), film.getHeight(), pixels.data()))
+  {
+    std::cout << "ERROR: Image (" << output << ") could not be saved!\n";
+    return 1;
+  }
+  return 0;
+}
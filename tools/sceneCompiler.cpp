@@ -0,0 +1,15 @@
+#include <iostream>
+
+#include "sceneFile.hpp"
+
+//PathTracerSceneCompiler scene.txt scene.ptscene -- compiles a text scene description into
+//the binary scene format, which PathTracer --scene loads without parsing or building anything
+int main(int argc, char** argv)
+{
+  if(argc < 3)
+  {
+    std::cout << "Usage: " << argv[0] << " scene.txt scene.ptscene\n";
+    return 1;
+  }
+  return compileScene(argv[1], argv[2]) ? 0 : 1;
+}
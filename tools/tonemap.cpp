@@ -0,0 +1,71 @@
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include "utils.hpp"
+#include "film.hpp"
+#include "imageFile.hpp"
+#include "postProcess.hpp"
+
+//PathTracerTonemap input output.ppm [exposure] [key] -- tone maps an HDR image (PFM, as
+//written by PathTracer, or a checkpoint of a progressive render) into a PPM. exposure scales
+//the linear radiance by that many stops before the Reinhard curve (default 0), key is the
+//value the log-average luminance maps to at exposure 0 (default 0.18).
+int main(int argc, char** argv)
+{
+  if(argc < 3)
+  {
+    std::cout << "Usage: " << argv[0] << " input output.ppm [exposure] [key]\n";
+    return 1;
+  }
+  const char* input = argv[1];
+  const char* output = argv[2];
+
+  PostProcess post;
+  std::vector<Vector> image;
+  int width, height;
+  ImageFile file(input);
+  Film film;
+  if(file.isValid())
+  {
+    width = file.getWidth();
+    height = file.getHeight();
+    std::vector<float> rgb = file.getLinear();
+    image.resize(rgb.size() / 3);
+    for(size_t i = 0; i < image.size(); ++i)
+      image[i] = Vector(rgb[3*i], rgb[3*i+1], rgb[3*i+2]);
+  }
+  else if(film.load(input))
+  {
+    width = film.getWidth();
+    height = film.getHeight();
+    post.resolve(film, image);
+  }
+  else
+  {
+    std::cout << "ERROR: HDR image (" << input << ") could not be loaded!\n";
+    return 1;
+  }
+
+  std::shared_ptr<ReinhardOperator> reinhard = std::make_shared<ReinhardOperator>();
+  if(argc > 4)
+    reinhard->KEY = std::atof(argv[4]);
+  //Reinhard divides by the log-average, which would undo scaling the radiance beforehand.
+  //The exposure scales the key instead, the radiance reaches the curve scaled by it and
+  //highlights are compressed rather than clipped.
+  if(argc > 3)
+    reinhard->KEY *= std::exp2(std::atof(argv[3]));
+  post.addOperator(reinhard);
+  post.apply(image);
+
+  std::vector<char> pixels(3 * image.size());
+  post.encodeSRGB(image, pixels.data());
+  if(!savePPM(output, width, height, pixels.data()))
+  {
+    std::cout << "ERROR: Image (" << output << ") could not be saved!\n";
+    return 1;
+  }
+  return 0;
+}